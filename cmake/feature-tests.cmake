@@ -0,0 +1,65 @@
+enable_testing()
+
+add_executable(notification-frame-test)
+
+target_sources(notification-frame-test PRIVATE test/frame-coverage-test.cpp notification-frame.cpp
+                                               notification-frame.hpp)
+
+target_include_directories(notification-frame-test PRIVATE "${CMAKE_CURRENT_SOURCE_DIR}")
+target_compile_features(notification-frame-test PRIVATE cxx_std_17)
+target_link_libraries(notification-frame-test PRIVATE OBS::libobs)
+
+set_target_properties(notification-frame-test PROPERTIES FOLDER plugins/spt-notification/test)
+
+add_test(NAME notification-frame-coverage COMMAND notification-frame-test)
+
+if(OS_LINUX)
+  find_package(OpenGL REQUIRED COMPONENTS EGL OpenGL)
+
+  add_executable(notification-gl-upload-test)
+
+  target_sources(notification-gl-upload-test PRIVATE test/gl-upload-test.cpp notification-gl-upload.cpp
+                                                     notification-gl-upload.hpp notification-frame.cpp)
+
+  # Only the libobs headers, the test provides the few functions the upload ring calls
+  target_include_directories(notification-gl-upload-test PRIVATE "${CMAKE_CURRENT_SOURCE_DIR}"
+                                                                 $<TARGET_PROPERTY:OBS::libobs,INTERFACE_INCLUDE_DIRECTORIES>)
+  target_compile_features(notification-gl-upload-test PRIVATE cxx_std_17)
+  target_link_libraries(notification-gl-upload-test PRIVATE OpenGL::EGL OpenGL::OpenGL ${CMAKE_DL_LIBS})
+
+  set_target_properties(notification-gl-upload-test PROPERTIES FOLDER plugins/spt-notification/test)
+
+  add_test(NAME notification-gl-upload COMMAND notification-gl-upload-test)
+  add_test(NAME notification-gl-upload-fallback COMMAND notification-gl-upload-test --fallback)
+  set_tests_properties(notification-gl-upload PROPERTIES ENVIRONMENT "LIBGL_ALWAYS_SOFTWARE=1" SKIP_RETURN_CODE 77)
+  set_tests_properties(
+    notification-gl-upload-fallback
+    PROPERTIES ENVIRONMENT
+               "LIBGL_ALWAYS_SOFTWARE=1;MESA_GL_VERSION_OVERRIDE=3.3;MESA_EXTENSION_OVERRIDE=-GL_ARB_buffer_storage"
+               SKIP_RETURN_CODE 77)
+endif()
+
+# The benchmarks load the plugin built here into a bare libobs. They need a display and are not part of ctest.
+find_package(Qt6 REQUIRED Widgets)
+
+function(notification_add_benchmark target)
+  add_executable(${target})
+
+  target_sources(${target} PRIVATE ${ARGN} test/bench-common.cpp test/bench-common.hpp)
+
+  target_compile_definitions(
+    ${target} PRIVATE NOTIFICATION_BENCH_MODULE="$<TARGET_FILE:spt-notification>"
+                      NOTIFICATION_BENCH_MODULE_DATA="${CMAKE_CURRENT_SOURCE_DIR}/data"
+                      NOTIFICATION_BENCH_DATA="${CMAKE_CURRENT_SOURCE_DIR}/test/data")
+  target_compile_features(${target} PRIVATE cxx_std_17)
+  target_link_libraries(${target} PRIVATE OBS::libobs Qt::Widgets nlohmann_json::nlohmann_json)
+  if(OS_LINUX)
+    target_link_libraries(${target} PRIVATE X11::X11)
+  endif()
+
+  add_dependencies(${target} spt-notification)
+  set_target_properties(${target} PROPERTIES FOLDER plugins/spt-notification/test)
+endfunction()
+
+notification_add_benchmark(notification-multiview-bench test/multiview-bench.cpp)
+notification_add_benchmark(notification-input-latency-bench test/input-latency-bench.cpp)
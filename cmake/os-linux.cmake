@@ -1,8 +1,10 @@
 find_package(X11 REQUIRED)
 
-target_compile_definitions(spt-notification PRIVATE ENABLE_NOTIFICATION_QT_LOOP)
+target_compile_definitions(spt-notification PRIVATE ENABLE_NOTIFICATION_QT_LOOP ENABLE_NOTIFICATION_GL_UPLOAD)
 
-target_link_libraries(spt-notification PRIVATE CEF::Wrapper CEF::Library X11::X11)
+target_sources(spt-notification PRIVATE notification-gl-upload.cpp notification-gl-upload.hpp)
+
+target_link_libraries(spt-notification PRIVATE CEF::Wrapper CEF::Library X11::X11 ${CMAKE_DL_LIBS})
 set_target_properties(spt-notification PROPERTIES BUILD_RPATH "$ORIGIN/" INSTALL_RPATH "$ORIGIN/")
 
 add_executable(notification-helper)
@@ -105,7 +105,8 @@ std::vector<std::string> exposedFunctions = {"getControlLevel",     "getCurrentS
 					     "startReplayBuffer",   "stopReplayBuffer", "saveReplayBuffer",
 					     "startVirtualcam",     "stopVirtualcam",   "getScenes",
 					     "setCurrentScene",     "getTransitions",   "getCurrentTransition",
-					     "setCurrentTransition"};
+					     "setCurrentTransition", "startBakedAnimation", "stopBakedAnimation",
+					     "playBakedAnimation"};
 
 void NotificationApp::OnContextCreated(CefRefPtr<CefBrowser> notification, CefRefPtr<CefFrame>, CefRefPtr<CefV8Context> context)
 {
@@ -435,30 +436,6 @@ bool NotificationApp::Execute(const CefString &name, CefRefPtr<CefV8Value>, cons
 Q_DECLARE_METATYPE(MessageTask);
 MessageObject messageObject;
 
-void QueueNotificationTask(CefRefPtr<CefBrowser> notification, NotificationFunc func)
-{
-	std::lock_guard<std::mutex> lock(messageObject.notificationTaskMutex);
-	messageObject.notificationTasks.emplace_back(notification, func);
-
-	QMetaObject::invokeMethod(&messageObject, "ExecuteNextNotificationTask", Qt::QueuedConnection);
-}
-
-bool MessageObject::ExecuteNextNotificationTask()
-{
-	Task nextTask;
-	{
-		std::lock_guard<std::mutex> lock(notificationTaskMutex);
-		if (!notificationTasks.size())
-			return false;
-
-		nextTask = notificationTasks[0];
-		notificationTasks.pop_front();
-	}
-
-	nextTask.func(nextTask.notification);
-	return true;
-}
-
 void MessageObject::ExecuteTask(MessageTask task)
 {
 	task();
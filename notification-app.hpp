@@ -29,34 +29,17 @@ typedef std::function<void(CefRefPtr<CefBrowser>)> NotificationFunc;
 #include <QObject>
 #include <QTimer>
 #include <mutex>
-#include <deque>
 
 typedef std::function<void()> MessageTask;
 
 class MessageObject : public QObject {
 	Q_OBJECT
 
-	friend void QueueNotificationTask(CefRefPtr<CefBrowser> notification, NotificationFunc func);
-
-	struct Task {
-		CefRefPtr<CefBrowser> notification;
-		NotificationFunc func;
-
-		inline Task() {}
-		inline Task(CefRefPtr<CefBrowser> notification_, NotificationFunc func_) : notification(notification_), func(func_) {}
-	};
-
-	std::mutex notificationTaskMutex;
-	std::deque<Task> notificationTasks;
-
 public slots:
-	bool ExecuteNextNotificationTask();
 	void ExecuteTask(MessageTask task);
 	void DoCefMessageLoop(int ms);
 	void Process();
 };
-
-extern void QueueNotificationTask(CefRefPtr<CefBrowser> notification, NotificationFunc func);
 #endif
 
 class NotificationApp : public CefApp, public CefRenderProcessHandler, public CefBrowserProcessHandler, public CefV8Handler {
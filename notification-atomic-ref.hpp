@@ -0,0 +1,97 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+
+#include "cef-headers.hpp"
+
+/* A CefRefPtr that is published by one side and read from any thread without
+ * taking a lock.
+ *
+ * Readers announce themselves in the reader count of the current epoch, load
+ * the pointer and take their own reference, and only retry when a store moved
+ * the epoch on in between. A store swaps the pointer, moves on to the next
+ * epoch and waits for the readers still counted in the old one before it
+ * drops the reference of the old pointer. Readers that show up after the swap
+ * can only see the new pointer, so they never hold up a store, and a store
+ * only ever waits for the few instructions a reader needs to take its
+ * reference. Stores are serialized among themselves. */
+template<typename T> class AtomicRefPtr {
+public:
+	AtomicRefPtr() = default;
+	AtomicRefPtr(const AtomicRefPtr &) = delete;
+	AtomicRefPtr &operator=(const AtomicRefPtr &) = delete;
+
+	inline ~AtomicRefPtr()
+	{
+		T *old = ptr.load(std::memory_order_relaxed);
+		if (old)
+			old->Release();
+	}
+
+	CefRefPtr<T> Load() const
+	{
+		/* Only a count made while the epoch stays the same is seen by
+		 * the store that moves on from it */
+		uint32_t current = epoch.load(std::memory_order_seq_cst);
+		for (;;) {
+			epoch_readers[current & 1].fetch_add(1, std::memory_order_seq_cst);
+			const uint32_t check = epoch.load(std::memory_order_seq_cst);
+			if (check == current)
+				break;
+
+			epoch_readers[current & 1].fetch_sub(1, std::memory_order_release);
+			current = check;
+		}
+
+		CefRefPtr<T> ref = ptr.load(std::memory_order_seq_cst);
+		epoch_readers[current & 1].fetch_sub(1, std::memory_order_release);
+		return ref;
+	}
+
+	void Store(CefRefPtr<T> value)
+	{
+		T *raw = value.get();
+		if (raw)
+			raw->AddRef();
+
+		std::lock_guard<std::mutex> lock(store_mutex);
+		T *old = ptr.exchange(raw, std::memory_order_seq_cst);
+		if (!old)
+			return;
+
+		const uint32_t previous = epoch.fetch_add(1, std::memory_order_seq_cst);
+		while (epoch_readers[previous & 1].load(std::memory_order_seq_cst))
+			std::this_thread::yield();
+
+		old->Release();
+	}
+
+	/* Only tells whether something is published, without a reference */
+	inline explicit operator bool() const { return ptr.load(std::memory_order_relaxed) != nullptr; }
+
+private:
+	std::atomic<T *> ptr = nullptr;
+	std::atomic<uint32_t> epoch = 0;
+	mutable std::atomic<int> epoch_readers[2] = {};
+	std::mutex store_mutex;
+};
@@ -0,0 +1,212 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "notification-bake.hpp"
+#include <obs.h>
+#include <algorithm>
+#include <functional>
+#include <string.h>
+#include <string_view>
+
+using namespace std;
+
+/* A token with RUN set is followed by one pixel repeated count times,
+ * otherwise by count literal pixels */
+static constexpr uint32_t RUN = 0x80000000;
+static constexpr uint32_t COUNT_MASK = 0x7FFFFFFF;
+/* Shorter repeats are cheaper as part of a literal */
+static constexpr int MIN_RUN = 3;
+
+static void EncodeRect(const uint8_t *buffer, uint32_t linesize, const FrameRect &rect, vector<uint32_t> &runs)
+{
+	size_t literal = SIZE_MAX;
+
+	for (int y = rect.y; y < rect.Bottom(); y++) {
+		const uint32_t *row = reinterpret_cast<const uint32_t *>(buffer + (size_t)y * linesize) + rect.x;
+
+		for (int x = 0; x < rect.cx;) {
+			const uint32_t pixel = row[x];
+			int count = 1;
+			while (x + count < rect.cx && row[x + count] == pixel)
+				count++;
+
+			if (count >= MIN_RUN) {
+				runs.push_back(RUN | (uint32_t)count);
+				runs.push_back(pixel);
+				literal = SIZE_MAX;
+			} else {
+				if (literal == SIZE_MAX) {
+					literal = runs.size();
+					runs.push_back(0);
+				}
+				runs[literal] += (uint32_t)count;
+				runs.insert(runs.end(), (size_t)count, pixel);
+			}
+
+			x += count;
+		}
+	}
+}
+
+static void DecodeRect(const vector<uint32_t> &runs, vector<uint32_t> &pixels)
+{
+	auto out = pixels.begin();
+
+	for (size_t i = 0; i < runs.size();) {
+		const uint32_t token = runs[i++];
+		const size_t count = token & COUNT_MASK;
+
+		if (token & RUN) {
+			out = fill_n(out, count, runs[i++]);
+		} else {
+			out = copy_n(runs.begin() + i, count, out);
+			i += count;
+		}
+	}
+}
+
+static size_t HashRuns(const vector<uint32_t> &runs)
+{
+	const string_view bytes(reinterpret_cast<const char *>(runs.data()), runs.size() * sizeof(uint32_t));
+	return hash<string_view>()(bytes);
+}
+
+BakedClip::~BakedClip()
+{
+	const bool uploaded = any_of(images.begin(), images.end(), [](const Image &image) { return image.texture; });
+	if (!uploaded)
+		return;
+
+	obs_enter_graphics();
+	ReleaseTextures();
+	obs_leave_graphics();
+}
+
+bool BakedClip::AddFrame(const uint8_t *buffer, int width_, int height_, const FrameRect &bounds, uint64_t time_ns)
+{
+	if (frames.empty()) {
+		start_time = time_ns;
+		width = width_;
+		height = height_;
+	} else if (width_ != width || height_ != height) {
+		return false;
+	}
+
+	const uint64_t time = time_ns - start_time;
+	if (time > MAX_DURATION_NS)
+		return false;
+
+	Frame frame = {time, -1};
+
+	if (!bounds.Empty()) {
+		Image image;
+		image.rect = bounds;
+		EncodeRect(buffer, (uint32_t)width * 4, bounds, image.runs);
+		image.hash = HashRuns(image.runs);
+
+		for (size_t i = 0; i < images.size(); i++) {
+			const Image &other = images[i];
+			if (other.hash == image.hash && other.rect.x == bounds.x && other.rect.y == bounds.y &&
+			    other.rect.cx == bounds.cx && other.rect.cy == bounds.cy && other.runs == image.runs) {
+				frame.image = (int)i;
+				break;
+			}
+		}
+
+		if (frame.image < 0) {
+			bytes += image.runs.size() * sizeof(uint32_t);
+			if (bytes > MAX_BYTES)
+				return false;
+
+			image.runs.shrink_to_fit();
+			images.push_back(std::move(image));
+			frame.image = (int)images.size() - 1;
+		}
+	}
+
+	frames.push_back(frame);
+	return true;
+}
+
+void BakedClip::Finish(uint64_t time_ns)
+{
+	if (frames.empty())
+		return;
+
+	/* The last frame holds until the recording was stopped */
+	duration = max(time_ns - start_time, frames.back().time + 1);
+}
+
+int BakedClip::FrameAt(uint64_t offset_ns) const
+{
+	if (offset_ns >= duration)
+		return -1;
+
+	auto next = upper_bound(frames.begin(), frames.end(), offset_ns,
+				[](uint64_t offset, const Frame &frame) { return offset < frame.time; });
+	return next == frames.begin() ? -1 : (int)(next - frames.begin()) - 1;
+}
+
+gs_texture_t *BakedClip::GetTexture(int idx, FrameRect &rect)
+{
+	if (idx < 0 || (size_t)idx >= frames.size() || frames[idx].image < 0)
+		return nullptr;
+
+	Image &image = images[frames[idx].image];
+	rect = image.rect;
+	image.last_used = ++texture_uses;
+
+	if (!image.texture) {
+		vector<uint32_t> pixels((size_t)rect.cx * rect.cy);
+		DecodeRect(image.runs, pixels);
+
+		const uint8_t *data = reinterpret_cast<const uint8_t *>(pixels.data());
+		image.texture = gs_texture_create(rect.cx, rect.cy, GS_BGRA, 1, &data, 0);
+		if (image.texture) {
+			texture_bytes += pixels.size() * sizeof(uint32_t);
+			EvictTextures(&image);
+		}
+	}
+
+	return image.texture;
+}
+
+void BakedClip::EvictTextures(const Image *keep)
+{
+	while (texture_bytes > MAX_TEXTURE_BYTES) {
+		Image *oldest = nullptr;
+		for (Image &image : images) {
+			if (image.texture && &image != keep && (!oldest || image.last_used < oldest->last_used))
+				oldest = &image;
+		}
+		if (!oldest)
+			return;
+
+		gs_texture_destroy(oldest->texture);
+		oldest->texture = nullptr;
+		texture_bytes -= (size_t)oldest->rect.cx * oldest->rect.cy * sizeof(uint32_t);
+	}
+}
+
+void BakedClip::ReleaseTextures()
+{
+	for (Image &image : images) {
+		gs_texture_destroy(image.texture);
+		image.texture = nullptr;
+	}
+	texture_bytes = 0;
+}
@@ -0,0 +1,95 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <graphics/graphics.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "notification-frame.hpp"
+
+/* A page animation recorded from the software frame path, so it can be
+ * played again without the browser.
+ *
+ * Frames are trimmed to their visible content and run-length encoded, which
+ * is what makes mostly transparent overlays small. Frames that are identical
+ * to one recorded earlier in the clip only reference it. Paints that did not
+ * change anything never reach the clip, every frame simply holds until the
+ * next one.
+ *
+ * Recording happens on the CEF thread. Once finished the clip does not change
+ * any more and is played back on the graphics thread, each distinct frame is
+ * decoded and uploaded into a texture the first time it is drawn. Uploaded
+ * frames are kept up to MAX_TEXTURE_BYTES, past that the ones drawn longest
+ * ago are freed again. */
+class BakedClip {
+public:
+	static constexpr uint64_t MAX_DURATION_NS = 10000000000ULL;
+	static constexpr size_t MAX_BYTES = 128 * 1024 * 1024;
+	static constexpr size_t MAX_TEXTURE_BYTES = 64 * 1024 * 1024;
+
+	~BakedClip();
+
+	/* CEF thread. Returns false once the clip is over its limits. */
+	bool AddFrame(const uint8_t *buffer, int width, int height, const FrameRect &bounds, uint64_t time_ns);
+	void Finish(uint64_t time_ns);
+
+	inline bool Empty() const { return frames.empty(); }
+	inline int Width() const { return width; }
+	inline int Height() const { return height; }
+	inline uint64_t Duration() const { return duration; }
+	inline size_t Frames() const { return frames.size(); }
+	inline size_t Images() const { return images.size(); }
+	inline size_t Bytes() const { return bytes; }
+
+	/* Graphics thread. Index of the frame shown at offset into the clip,
+	 * or -1 past its end. */
+	int FrameAt(uint64_t offset_ns) const;
+	/* Graphics thread. nullptr for frames without visible content. */
+	gs_texture_t *GetTexture(int idx, FrameRect &rect);
+	/* Graphics thread. Frees all uploaded frames. */
+	void ReleaseTextures();
+
+private:
+	struct Image {
+		FrameRect rect;
+		size_t hash = 0;
+		std::vector<uint32_t> runs;
+		gs_texture_t *texture = nullptr;
+		uint64_t last_used = 0;
+	};
+
+	void EvictTextures(const Image *keep);
+
+	struct Frame {
+		uint64_t time;
+		/* Index into images, -1 for fully transparent frames */
+		int image;
+	};
+
+	std::vector<Image> images;
+	std::vector<Frame> frames;
+	uint64_t start_time = 0;
+	uint64_t duration = 0;
+	size_t bytes = 0;
+	size_t texture_bytes = 0;
+	uint64_t texture_uses = 0;
+	int width = 0;
+	int height = 0;
+};
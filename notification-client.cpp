@@ -18,6 +18,7 @@
 
 #include "notification-client.hpp"
 #include "spt-notification-source.hpp"
+#include "notification-frame.hpp"
 #include "base64/base64.hpp"
 #include <nlohmann/json.hpp>
 #include <obs-frontend-api.h>
@@ -183,6 +184,13 @@ bool NotificationClient::OnProcessMessageReceived(CefRefPtr<CefBrowser> notifica
 	case ControlLevel::Basic:
 		if (name == "saveReplayBuffer") {
 			obs_frontend_replay_buffer_save();
+		} else if (name == "startBakedAnimation") {
+			bs->StartBake(input_args->GetString(1).ToString());
+			notification->GetHost()->Invalidate(PET_VIEW);
+		} else if (name == "stopBakedAnimation") {
+			bs->StopBake();
+		} else if (name == "playBakedAnimation") {
+			json = bs->PlayBaked(input_args->GetString(1).ToString());
 		}
 		[[fallthrough]];
 	case ControlLevel::ReadUser:
@@ -257,7 +265,23 @@ void NotificationClient::GetViewRect(CefRefPtr<CefBrowser>, CefRect &rect)
 		return;
 	}
 
-	rect.Set(0, 0, bs->width < 1 ? 1 : bs->width, bs->height < 1 ? 1 : bs->height);
+	const FrameRect view = bs->GetViewport();
+	rect.Set(0, 0, view.cx, view.cy);
+}
+
+bool NotificationClient::GetScreenInfo(CefRefPtr<CefBrowser> notification, CefScreenInfo &screen_info)
+{
+	if (!valid())
+		return false;
+
+	/* The view keeps its size in DIPs, a lower scale factor only makes
+	 * CEF paint fewer pixels for it */
+	CefRect rect;
+	GetViewRect(notification, rect);
+	screen_info.device_scale_factor = bs->view_scale;
+	screen_info.rect = rect;
+	screen_info.available_rect = rect;
+	return true;
 }
 
 bool NotificationClient::OnTooltip(CefRefPtr<CefBrowser>, CefString &text)
@@ -268,14 +292,47 @@ bool NotificationClient::OnTooltip(CefRefPtr<CefBrowser>, CefString &text)
 	return true;
 }
 
-void NotificationClient::OnPaint(CefRefPtr<CefBrowser>, PaintElementType type, const RectList &, const void *buffer,
-			    int width, int height)
+void NotificationClient::OnPopupShow(CefRefPtr<CefBrowser>, bool show)
 {
-	if (type != PET_VIEW) {
-		// TODO Overlay texture on top of bs->texture
+	if (!valid()) {
 		return;
 	}
 
+	if (!show) {
+		popupRect.Set(0, 0, 0, 0);
+		originalPopupRect.Set(0, 0, 0, 0);
+	}
+
+	bs->popup_visible = show;
+}
+
+void NotificationClient::OnPopupSize(CefRefPtr<CefBrowser>, const CefRect &rect)
+{
+	if (!valid() || rect.width <= 0 || rect.height <= 0) {
+		return;
+	}
+
+	originalPopupRect = rect;
+	popupRect = rect;
+
+	/* Keep the popup inside of the view if possible */
+	const FrameRect view = bs->GetViewport();
+	if (popupRect.x + popupRect.width > view.cx)
+		popupRect.x = view.cx - popupRect.width;
+	if (popupRect.y + popupRect.height > view.cy)
+		popupRect.y = view.cy - popupRect.height;
+	if (popupRect.x < 0)
+		popupRect.x = 0;
+	if (popupRect.y < 0)
+		popupRect.y = 0;
+
+	bs->popup_x = popupRect.x;
+	bs->popup_y = popupRect.y;
+}
+
+void NotificationClient::OnPaint(CefRefPtr<CefBrowser>, PaintElementType type, const RectList &dirtyRects,
+			    const void *buffer, int width, int height)
+{
 #ifdef ENABLE_BROWSER_SHARED_TEXTURE
 	if (sharing_available) {
 		return;
@@ -286,23 +343,68 @@ void NotificationClient::OnPaint(CefRefPtr<CefBrowser>, PaintElementType type, c
 		return;
 	}
 
-	if (bs->width != width || bs->height != height) {
-		obs_enter_graphics();
-		bs->DestroyTextures();
-		obs_leave_graphics();
+	if (type == PET_POPUP) {
+		/* Popups are small and short-lived, they are always staged
+		 * whole and get their own texture so they never cause the
+		 * view to be uploaded again */
+		FrameCoverage popup;
+		popup.bounds = FrameRect(0, 0, width, height);
+		DirtyRegion dirty;
+		dirty.Add(popup.bounds);
+
+		bs->popup_frames.Publish((const uint8_t *)buffer, width, height, dirty, popup);
+		return;
+	}
+
+	/* Only stage the frame here, the texture upload happens on the
+	 * graphics thread so the CEF thread never has to wait for it */
+	DirtyRegion dirty;
+	for (const CefRect &rect : dirtyRects)
+		dirty.Add(FrameRect(rect.x, rect.y, rect.width, rect.height).Clip(width, height));
+
+	const uint64_t dirty_bytes = (uint64_t)dirty.Area() * 4;
+	bs->stats.frames_painted++;
+	bs->stats.bytes_painted += dirty_bytes;
+	bs->InputPainted();
+
+	if (bs->change_detection) {
+		DirtyRegion changed;
+		const bool any_changed = bs->tile_hasher.Filter((const uint8_t *)buffer, width, height, dirty, changed);
+		const uint64_t changed_bytes = (uint64_t)changed.Area() * 4;
+
+		if (changed_bytes < dirty_bytes)
+			bs->stats.bytes_skipped += dirty_bytes - changed_bytes;
+		if (!any_changed) {
+			bs->stats.frames_unchanged++;
+			return;
+		}
+
+		dirty = changed;
+	} else {
+		bs->tile_hasher.Reset();
 	}
 
-	if (!bs->texture && width && height) {
-		obs_enter_graphics();
-		bs->texture = gs_texture_create(width, height, GS_BGRA, 1, (const uint8_t **)&buffer, GS_DYNAMIC);
-		bs->width = width;
-		bs->height = height;
-		obs_leave_graphics();
+	/* Overlays are mostly transparent, only their visible part has to be
+	 * uploaded and drawn. The coverage also tells empty and solid frames
+	 * apart, which matters with trimming off as well, so it is kept up to
+	 * date either way. */
+	FrameCoverage coverage;
+	if (width == coverage_cx && height == coverage_cy) {
+		coverage = UpdateFrameCoverage(last_coverage, (const uint8_t *)buffer, width, height,
+					       (uint32_t)width * 4, dirty);
 	} else {
-		obs_enter_graphics();
-		gs_texture_set_image(bs->texture, (const uint8_t *)buffer, width * 4, false);
-		obs_leave_graphics();
+		coverage = ScanFrameCoverage((const uint8_t *)buffer, width, height, (uint32_t)width * 4);
+		coverage_cx = width;
+		coverage_cy = height;
 	}
+	last_coverage = coverage;
+	bs->frame_alpha = coverage.Classify(width, height);
+
+	bs->frames.Publish((const uint8_t *)buffer, width, height, dirty, coverage);
+	bs->content_generation++;
+
+	if (bs->bake_recording)
+		bs->RecordBakeFrame((const uint8_t *)buffer, width, height, coverage.bounds);
 }
 
 #ifdef ENABLE_BROWSER_SHARED_TEXTURE
@@ -322,6 +424,7 @@ void NotificationClient::UpdateExtraTexture()
 					bs->extra_texture = nullptr;
 				}
 				bs->extra_texture = gs_texture_create(cx, cy, linear_format, 1, nullptr, 0);
+				bs->extra_generation = 0;
 				bs->last_cx = cx;
 				bs->last_cy = cy;
 				bs->last_format = linear_format;
@@ -329,6 +432,7 @@ void NotificationClient::UpdateExtraTexture()
 		} else if (bs->extra_texture) {
 			gs_texture_destroy(bs->extra_texture);
 			bs->extra_texture = nullptr;
+			bs->extra_generation = 0;
 			bs->last_cx = 0;
 			bs->last_cy = 0;
 			bs->last_format = GS_UNKNOWN;
@@ -343,50 +447,62 @@ void NotificationClient::OnAcceleratedPaint(CefRefPtr<CefBrowser>, PaintElementT
 				       void *shared_handle)
 #endif
 {
-	if (type != PET_VIEW) {
-		// TODO Overlay texture on top of bs->texture
+	if (!valid()) {
 		return;
 	}
 
-	if (!valid()) {
-		return;
+	/* Popups get their own texture which Render draws over the view */
+	const bool popup = type == PET_POPUP;
+	gs_texture_t *&target = popup ? bs->popup_texture : bs->texture;
+
+	/* Even when the handle did not change CEF painted into it */
+	if (!popup) {
+		bs->content_generation++;
+		bs->InputPainted();
 	}
 
 #if !defined(_WIN32) && CHROME_VERSION_BUILD < 6367
-	if (shared_handle == bs->last_handle)
+	if (!popup && shared_handle == bs->last_handle)
 		return;
 #endif
 
 	obs_enter_graphics();
 
-	if (bs->texture) {
+	if (target) {
 #ifdef _WIN32
-		//gs_texture_release_sync(bs->texture, 0);
+		//gs_texture_release_sync(target, 0);
 #endif
-		gs_texture_destroy(bs->texture);
-		bs->texture = nullptr;
+		gs_texture_destroy(target);
+		target = nullptr;
 	}
 
 #if defined(__APPLE__) && CHROME_VERSION_BUILD > 6367
-	bs->texture = gs_texture_create_from_iosurface((IOSurfaceRef)(uintptr_t)info.shared_texture_io_surface);
+	target = gs_texture_create_from_iosurface((IOSurfaceRef)(uintptr_t)info.shared_texture_io_surface);
 #elif defined(__APPLE__) && CHROME_VERSION_BUILD > 4183
-	bs->texture = gs_texture_create_from_iosurface((IOSurfaceRef)(uintptr_t)shared_handle);
+	target = gs_texture_create_from_iosurface((IOSurfaceRef)(uintptr_t)shared_handle);
 #elif defined(_WIN32) && CHROME_VERSION_BUILD > 4183
-	bs->texture =
+	target =
 #if CHROME_VERSION_BUILD >= 6367
 		gs_texture_open_nt_shared((uint32_t)(uintptr_t)info.shared_texture_handle);
 #else
 		gs_texture_open_nt_shared((uint32_t)(uintptr_t)shared_handle);
 #endif
-	//if (bs->texture)
-	//	gs_texture_acquire_sync(bs->texture, 1, INFINITE);
+	//if (target)
+	//	gs_texture_acquire_sync(target, 1, INFINITE);
 
 #else
-	bs->texture = gs_texture_open_shared((uint32_t)(uintptr_t)shared_handle);
+	target = gs_texture_open_shared((uint32_t)(uintptr_t)shared_handle);
 #endif
-	UpdateExtraTexture();
+	if (!popup)
+		UpdateExtraTexture();
 	obs_leave_graphics();
 
+	if (popup)
+		return;
+
+	/* Shared textures never reach the CPU, so their alpha is unknown */
+	bs->frame_alpha = FrameAlpha::Mixed;
+
 #if defined(__APPLE__) && CHROME_VERSION_BUILD >= 6367
 	bs->last_handle = info.shared_texture_io_surface;
 #elif CHROME_VERSION_BUILD >= 6367
@@ -400,36 +516,43 @@ void NotificationClient::OnAcceleratedPaint(CefRefPtr<CefBrowser>, PaintElementT
 void NotificationClient::OnAcceleratedPaint2(CefRefPtr<CefBrowser>, PaintElementType type, const RectList &,
 					void *shared_handle, bool new_texture)
 {
-	if (type != PET_VIEW) {
-		// TODO Overlay texture on top of bs->texture
+	if (!valid()) {
 		return;
 	}
 
-	if (!valid()) {
-		return;
+	const bool popup = type == PET_POPUP;
+	if (!popup) {
+		bs->content_generation++;
+		bs->InputPainted();
 	}
 
 	if (!new_texture) {
 		return;
 	}
 
+	gs_texture_t *&target = popup ? bs->popup_texture : bs->texture;
+
 	obs_enter_graphics();
 
-	if (bs->texture) {
-		gs_texture_destroy(bs->texture);
-		bs->texture = nullptr;
+	if (target) {
+		gs_texture_destroy(target);
+		target = nullptr;
 	}
 
 #if defined(__APPLE__) && CHROME_VERSION_BUILD > 4183
-	bs->texture = gs_texture_create_from_iosurface((IOSurfaceRef)(uintptr_t)shared_handle);
+	target = gs_texture_create_from_iosurface((IOSurfaceRef)(uintptr_t)shared_handle);
 #elif defined(_WIN32) && CHROME_VERSION_BUILD > 4183
-	bs->texture = gs_texture_open_nt_shared((uint32_t)(uintptr_t)shared_handle);
+	target = gs_texture_open_nt_shared((uint32_t)(uintptr_t)shared_handle);
 
 #else
-	bs->texture = gs_texture_open_shared((uint32_t)(uintptr_t)shared_handle);
+	target = gs_texture_open_shared((uint32_t)(uintptr_t)shared_handle);
 #endif
-	UpdateExtraTexture();
+	if (!popup)
+		UpdateExtraTexture();
 	obs_leave_graphics();
+
+	if (!popup)
+		bs->frame_alpha = FrameAlpha::Mixed;
 }
 #endif
 #endif
@@ -613,7 +736,7 @@ void NotificationClient::OnAudioStreamStopped(CefRefPtr<CefBrowser> notification
 }
 #endif
 
-void NotificationClient::OnLoadEnd(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame> frame, int)
+void NotificationClient::OnLoadEnd(CefRefPtr<CefBrowser> notification, CefRefPtr<CefFrame> frame, int)
 {
 	if (!valid()) {
 		return;
@@ -631,6 +754,9 @@ void NotificationClient::OnLoadEnd(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame> fr
 
 		frame->ExecuteJavaScript(script, "", 0);
 	}
+
+	if (frame->IsMain() && bs->viewport_mode != ViewportMode::Full)
+		bs->ApplyViewport(notification);
 }
 
 bool NotificationClient::OnConsoleMessage(CefRefPtr<CefBrowser>, cef_log_severity_t level, const CefString &message,
@@ -41,6 +41,12 @@ class NotificationClient : public CefClient,
 	bool reroute_audio = true;
 	ControlLevel webpage_control_level = DEFAULT_CONTROL_LEVEL;
 
+	/* Coverage of the last view frame, CEF thread. Zero sizes until a
+	 * frame was fully scanned. */
+	FrameCoverage last_coverage;
+	int coverage_cx = 0;
+	int coverage_cy = 0;
+
 	inline bool valid() const;
 
 	void UpdateExtraTexture();
@@ -113,6 +119,9 @@ public:
 
 	/* CefRenderHandler */
 	virtual void GetViewRect(CefRefPtr<CefBrowser> notification, CefRect &rect) override;
+	virtual bool GetScreenInfo(CefRefPtr<CefBrowser> notification, CefScreenInfo &screen_info) override;
+	virtual void OnPopupShow(CefRefPtr<CefBrowser> notification, bool show) override;
+	virtual void OnPopupSize(CefRefPtr<CefBrowser> notification, const CefRect &rect) override;
 	virtual void OnPaint(CefRefPtr<CefBrowser> notification, PaintElementType type, const RectList &dirtyRects,
 			     const void *buffer, int width, int height) override;
 #ifdef ENABLE_BROWSER_SHARED_TEXTURE
@@ -0,0 +1,293 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "notification-culling.hpp"
+#include "spt-notification-source.hpp"
+#include <graphics/matrix4.h>
+#include <graphics/vec3.h>
+#include <obs.hpp>
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+#include <unordered_map>
+
+using namespace std;
+
+static constexpr int MAX_NESTING = 16;
+
+struct CullPass {
+	unordered_map<obs_source_t *, CullResult *> targets;
+	vector<FrameRect> occluders;
+};
+
+/* Where an item's scene ends up on the canvas */
+struct CullParent {
+	matrix4 transform;
+	FrameRect clip;
+	/* False below filtered or blended parents, whose children can not be
+	 * trusted to hide anything */
+	bool can_occlude;
+	/* False below zero-opacity parents */
+	bool visible;
+};
+
+static bool GetFilterState(obs_source_t *source, bool *has_filters)
+{
+	struct FilterState {
+		bool any = false;
+		bool transparent = false;
+	} state;
+
+	obs_source_enum_filters(
+		source,
+		[](obs_source_t *, obs_source_t *filter, void *param) {
+			FilterState *state = static_cast<FilterState *>(param);
+			if (!obs_source_enabled(filter))
+				return;
+
+			state->any = true;
+
+			if (strcmp(obs_source_get_unversioned_id(filter), "color_filter") == 0) {
+				OBSDataAutoRelease settings = obs_source_get_settings(filter);
+				if (obs_data_get_double(settings, "opacity") <= 0.0)
+					state->transparent = true;
+			}
+		},
+		&state);
+
+	*has_filters = state.any;
+	return state.transparent;
+}
+
+static bool IsOpaqueSource(obs_source_t *source, const CullPass &pass)
+{
+	auto it = pass.targets.find(source);
+	if (it != pass.targets.end()) {
+		/* With a viewport only part of the item is drawn, the rest of
+		 * its bounds stays see-through */
+		NotificationSource *bs = it->second->bs;
+		return bs->viewport_mode == ViewportMode::Full && bs->GetFrameAlpha() == FrameAlpha::Opaque;
+	}
+
+	if (strcmp(obs_source_get_unversioned_id(source), "color_source") == 0) {
+		OBSDataAutoRelease settings = obs_source_get_settings(source);
+		return (obs_data_get_int(settings, "color") & 0xFF000000) == 0xFF000000;
+	}
+
+	return false;
+}
+
+/* Axis-aligned bounds of the unit square under transform. With inner set the
+ * bounds are rounded inwards, for areas that must be fully covered. */
+static FrameRect TransformedBounds(const matrix4 &transform, bool inner)
+{
+	float min_x = INFINITY, min_y = INFINITY;
+	float max_x = -INFINITY, max_y = -INFINITY;
+
+	for (int i = 0; i < 4; i++) {
+		vec3 corner;
+		vec3_set(&corner, (float)(i & 1), (float)(i >> 1), 0.0f);
+		vec3_transform(&corner, &corner, &transform);
+
+		min_x = min(min_x, corner.x);
+		min_y = min(min_y, corner.y);
+		max_x = max(max_x, corner.x);
+		max_y = max(max_y, corner.y);
+	}
+
+	const int l = (int)(inner ? ceilf(min_x) : floorf(min_x));
+	const int t = (int)(inner ? ceilf(min_y) : floorf(min_y));
+	const int r = (int)(inner ? floorf(max_x) : ceilf(max_x));
+	const int b = (int)(inner ? floorf(max_y) : ceilf(max_y));
+	return FrameRect(l, t, r - l, b - t);
+}
+
+static inline bool IsAxisAligned(const matrix4 &transform)
+{
+	return transform.x.y == 0.0f && transform.y.x == 0.0f;
+}
+
+/* Canvas pixels per source pixel along the larger of the two axes */
+static float PixelScale(const matrix4 &transform)
+{
+	return max(hypotf(transform.x.x, transform.x.y), hypotf(transform.y.x, transform.y.y));
+}
+
+static bool IsOccluded(const FrameRect &rect, const CullPass &pass)
+{
+	for (const FrameRect &occluder : pass.occluders) {
+		if (occluder.Contains(rect))
+			return true;
+	}
+
+	return false;
+}
+
+static void CheckItems(obs_scene_t *scene, const CullParent &parent, CullPass &pass, int depth);
+
+static void CheckItem(obs_sceneitem_t *item, const CullParent &parent, CullPass &pass, int depth)
+{
+	if (!obs_sceneitem_visible(item))
+		return;
+
+	obs_source_t *source = obs_sceneitem_get_source(item);
+
+	matrix4 box;
+	obs_sceneitem_get_box_transform(item, &box);
+	matrix4 transform;
+	matrix4_mul(&transform, &box, &parent.transform);
+
+	bool has_filters;
+	const bool transparent = GetFilterState(source, &has_filters);
+	const bool visible = parent.visible && !transparent;
+	const FrameRect bounds = TransformedBounds(transform, false).Intersect(parent.clip);
+
+	auto target = pass.targets.find(source);
+	if (target != pass.targets.end()) {
+		CullResult &result = *target->second;
+		result.seen = true;
+		if (visible && !bounds.Empty() && !IsOccluded(bounds, pass)) {
+			/* The draw transform maps source pixels, the box
+			 * transform the unit square */
+			matrix4 draw;
+			obs_sceneitem_get_draw_transform(item, &draw);
+			matrix4 pixel;
+			matrix4_mul(&pixel, &draw, &parent.transform);
+
+			obs_sceneitem_crop crop;
+			obs_sceneitem_get_crop(item, &crop);
+			const int cx = (int)obs_source_get_width(source) - crop.left - crop.right;
+			const int cy = (int)obs_source_get_height(source) - crop.top - crop.bottom;
+
+			result.visible = true;
+			result.scale = max(result.scale, PixelScale(pixel));
+			result.region = result.region.Union(FrameRect(crop.left, crop.top, cx, cy));
+		}
+	}
+
+	obs_scene_t *nested = obs_scene_from_source(source);
+	if (!nested)
+		nested = obs_group_from_source(source);
+
+	const bool normal = obs_sceneitem_get_blending_mode(item) == OBS_BLEND_NORMAL && !has_filters;
+
+	if (nested && depth < MAX_NESTING) {
+		/* Nested items are positioned in the nested scene, which the
+		 * item's draw transform maps onto the canvas after crop. Only
+		 * cropped items are drawn through a texture, everything else
+		 * can reach past the nested scene's size. */
+		obs_sceneitem_crop crop;
+		obs_sceneitem_get_crop(item, &crop);
+		const bool cropped = crop.left || crop.top || crop.right || crop.bottom;
+
+		matrix4 draw;
+		obs_sceneitem_get_draw_transform(item, &draw);
+		matrix4 offset;
+		matrix4_identity(&offset);
+		matrix4_translate3f(&offset, &offset, -(float)crop.left, -(float)crop.top, 0.0f);
+		matrix4 local;
+		matrix4_mul(&local, &offset, &draw);
+
+		CullParent child;
+		matrix4_mul(&child.transform, &local, &parent.transform);
+		child.clip = cropped ? bounds : parent.clip;
+		child.can_occlude = parent.can_occlude && normal;
+		child.visible = visible;
+
+		CheckItems(nested, child, pass, depth + 1);
+		return;
+	}
+
+	if (visible && parent.can_occlude && normal && IsAxisAligned(transform) && IsOpaqueSource(source, pass)) {
+		const FrameRect covered = TransformedBounds(transform, true).Intersect(parent.clip);
+		if (!covered.Empty())
+			pass.occluders.push_back(covered);
+	}
+}
+
+static void CheckItems(obs_scene_t *scene, const CullParent &parent, CullPass &pass, int depth)
+{
+	if (!scene)
+		return;
+
+	vector<obs_sceneitem_t *> items;
+	obs_scene_enum_items(
+		scene,
+		[](obs_scene_t *, obs_sceneitem_t *item, void *param) {
+			obs_sceneitem_addref(item);
+			static_cast<vector<obs_sceneitem_t *> *>(param)->push_back(item);
+			return true;
+		},
+		&items);
+
+	/* Items are listed bottom to top, occluders have to be known before
+	 * the items below them are checked */
+	for (auto it = items.rbegin(); it != items.rend(); ++it)
+		CheckItem(*it, parent, pass, depth);
+
+	for (obs_sceneitem_t *item : items)
+		obs_sceneitem_release(item);
+}
+
+void CheckNotificationVisibility(vector<CullResult> &results)
+{
+	if (results.empty())
+		return;
+
+	CullPass pass;
+	for (CullResult &result : results) {
+		result.seen = false;
+		result.visible = false;
+		result.scale = 0.0f;
+		result.region = FrameRect();
+		pass.targets[result.bs->source] = &result;
+	}
+
+	struct obs_video_info ovi;
+	if (!obs_get_video_info(&ovi))
+		return;
+
+	CullParent root;
+	matrix4_identity(&root.transform);
+	root.clip = FrameRect(0, 0, (int)ovi.base_width, (int)ovi.base_height);
+	root.can_occlude = true;
+	root.visible = true;
+
+	vector<obs_source_t *> scenes;
+	obs_enum_scenes(
+		[](void *param, obs_source_t *scene) {
+			if (obs_source_showing(scene)) {
+				obs_source_t *ref = obs_source_get_ref(scene);
+				if (ref)
+					static_cast<vector<obs_source_t *> *>(param)->push_back(ref);
+			}
+			return true;
+		},
+		&scenes);
+
+	/* Every showing scene is a view of its own (program, preview,
+	 * projectors), nested scenes are also checked on their own, which can
+	 * only ever make items more visible */
+	for (obs_source_t *scene : scenes) {
+		pass.occluders.clear();
+
+		obs_scene_t *nested = obs_scene_from_source(scene);
+		CheckItems(nested ? nested : obs_group_from_source(scene), root, pass, 0);
+
+		obs_source_release(scene);
+	}
+}
@@ -0,0 +1,55 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <vector>
+
+#include "notification-frame.hpp"
+
+struct NotificationSource;
+
+struct CullResult {
+	NotificationSource *bs;
+	/* At least one scene item of the source is in a showing scene */
+	bool seen = false;
+	/* At least one of those items can actually be seen */
+	bool visible = false;
+	/* Largest number of canvas pixels per source pixel among the items
+	 * that can be seen, 0 if none */
+	float scale = 0.0f;
+	/* Union of the parts of the source that those items do not crop
+	 * away, in source pixels */
+	FrameRect region;
+};
+
+/* Walks every showing scene from the top item down and checks each item of
+ * the given sources against the canvas, the opaque items above it and
+ * zero-opacity color filters. Nested scenes and groups are followed with
+ * their transform and crop.
+ *
+ * The checks are conservative: item bounds are the axis-aligned bounds of the
+ * transformed item, and only unfiltered, normally blended, axis-aligned items
+ * known to be fully opaque (opaque notification frames, solid color sources)
+ * hide what is below them. A source that is showing for other reasons than a
+ * scene (a source projector, the properties preview) is not seen and must
+ * not be culled.
+ *
+ * The walk also finds the largest on-canvas scale of each source, which is
+ * the resolution its page has to be rasterized at, and the part of it that
+ * survives scene item crop. */
+void CheckNotificationVisibility(std::vector<CullResult> &results);
@@ -0,0 +1,593 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "notification-frame.hpp"
+#include <util/sse-intrin.h>
+#include <algorithm>
+#include <string.h>
+
+using namespace std;
+
+/* ========================================================================= */
+
+FrameRect FrameRect::Clip(int width, int height) const
+{
+	const int l = max(x, 0);
+	const int t = max(y, 0);
+	const int r = min(Right(), width);
+	const int b = min(Bottom(), height);
+
+	if (r <= l || b <= t)
+		return FrameRect();
+
+	return FrameRect(l, t, r - l, b - t);
+}
+
+FrameRect FrameRect::Union(const FrameRect &other) const
+{
+	if (Empty())
+		return other;
+	if (other.Empty())
+		return *this;
+
+	const int l = min(x, other.x);
+	const int t = min(y, other.y);
+	const int r = max(Right(), other.Right());
+	const int b = max(Bottom(), other.Bottom());
+	return FrameRect(l, t, r - l, b - t);
+}
+
+FrameRect FrameRect::Intersect(const FrameRect &other) const
+{
+	const int l = max(x, other.x);
+	const int t = max(y, other.y);
+	const int r = min(Right(), other.Right());
+	const int b = min(Bottom(), other.Bottom());
+
+	if (r <= l || b <= t)
+		return FrameRect();
+
+	return FrameRect(l, t, r - l, b - t);
+}
+
+bool FrameRect::Touches(const FrameRect &other) const
+{
+	return x <= other.Right() && other.x <= Right() && y <= other.Bottom() && other.y <= Bottom();
+}
+
+bool FrameRect::Contains(const FrameRect &other) const
+{
+	if (other.Empty())
+		return true;
+
+	return x <= other.x && y <= other.y && Right() >= other.Right() && Bottom() >= other.Bottom();
+}
+
+/* ========================================================================= */
+
+/* Two rects are merged when they touch, or when the area their union wastes
+ * is small compared to what they cover; one larger copy is cheaper than two
+ * row-by-row walks over almost the same memory. */
+static inline bool ShouldMerge(const FrameRect &a, const FrameRect &b)
+{
+	if (a.Touches(b))
+		return true;
+
+	const int64_t covered = a.Area() + b.Area();
+	return a.Union(b).Area() <= covered + covered / 4;
+}
+
+void DirtyRegion::MergeOverlapping(size_t idx)
+{
+	bool merged = true;
+
+	while (merged) {
+		merged = false;
+
+		for (size_t i = 0; i < count; i++) {
+			if (i == idx || !ShouldMerge(rects[idx], rects[i]))
+				continue;
+
+			rects[idx] = rects[idx].Union(rects[i]);
+			rects[i] = rects[--count];
+			if (idx == count)
+				idx = i;
+
+			merged = true;
+			break;
+		}
+	}
+}
+
+void DirtyRegion::Add(const FrameRect &rect)
+{
+	if (rect.Empty())
+		return;
+
+	for (size_t i = 0; i < count; i++) {
+		if (ShouldMerge(rects[i], rect)) {
+			rects[i] = rects[i].Union(rect);
+			MergeOverlapping(i);
+			return;
+		}
+	}
+
+	if (count < MAX_RECTS) {
+		rects[count++] = rect;
+		return;
+	}
+
+	size_t best = 0;
+	int64_t best_growth = INT64_MAX;
+
+	for (size_t i = 0; i < count; i++) {
+		const int64_t growth = rects[i].Union(rect).Area() - rects[i].Area();
+		if (growth < best_growth) {
+			best_growth = growth;
+			best = i;
+		}
+	}
+
+	rects[best] = rects[best].Union(rect);
+	MergeOverlapping(best);
+}
+
+void DirtyRegion::Add(const DirtyRegion &region)
+{
+	for (size_t i = 0; i < region.count; i++)
+		Add(region.rects[i]);
+}
+
+int64_t DirtyRegion::Area() const
+{
+	int64_t area = 0;
+	for (size_t i = 0; i < count; i++)
+		area += rects[i].Area();
+	return area;
+}
+
+/* ========================================================================= */
+
+void CopyFrameRect(uint8_t *dst, uint32_t dst_linesize, const uint8_t *src, uint32_t src_linesize,
+		   const FrameRect &rect, int dst_x, int dst_y)
+{
+	const size_t row_size = (size_t)rect.cx * 4;
+
+	dst += (size_t)dst_y * dst_linesize + (size_t)dst_x * 4;
+	src += (size_t)rect.y * src_linesize + (size_t)rect.x * 4;
+
+	if (dst_linesize == src_linesize && row_size == dst_linesize) {
+		memcpy(dst, src, row_size * rect.cy);
+		return;
+	}
+
+	for (int y = 0; y < rect.cy; y++) {
+		memcpy(dst, src, row_size);
+		dst += dst_linesize;
+		src += src_linesize;
+	}
+}
+
+void ClearFrameBorder(uint8_t *dst, uint32_t linesize, int cx, int cy, int surface_cx, int surface_cy)
+{
+	if (cx < surface_cx) {
+		const int rows = min(cy + 1, surface_cy);
+		for (int y = 0; y < rows; y++)
+			memset(dst + (size_t)y * linesize + (size_t)cx * 4, 0, 4);
+	}
+	if (cy < surface_cy) {
+		const int cols = min(cx + 1, surface_cx);
+		memset(dst + (size_t)cy * linesize, 0, (size_t)cols * 4);
+	}
+}
+
+/* ========================================================================= */
+
+/* Alpha is the high byte of every little-endian BGRA pixel, so a block of
+ * four pixels is fully transparent when all of its 32-bit lanes are zero
+ * after masking. */
+
+static inline int TransparentMask(const uint8_t *px)
+{
+	const __m128i alpha_mask = _mm_set1_epi32((int)0xFF000000);
+	const __m128i alpha = _mm_and_si128(_mm_loadu_si128((const __m128i *)px), alpha_mask);
+	return _mm_movemask_epi8(_mm_cmpeq_epi32(alpha, _mm_setzero_si128()));
+}
+
+static bool AnyAlpha(const uint8_t *row, int count)
+{
+	const __m128i alpha_mask = _mm_set1_epi32((int)0xFF000000);
+	int i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		const __m128i *px = (const __m128i *)(row + (size_t)i * 4);
+		const __m128i a = _mm_or_si128(_mm_loadu_si128(px), _mm_loadu_si128(px + 1));
+		const __m128i b = _mm_or_si128(_mm_loadu_si128(px + 2), _mm_loadu_si128(px + 3));
+		const __m128i alpha = _mm_and_si128(_mm_or_si128(a, b), alpha_mask);
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, _mm_setzero_si128())) != 0xFFFF)
+			return true;
+	}
+	for (; i + 4 <= count; i += 4) {
+		if (TransparentMask(row + (size_t)i * 4) != 0xFFFF)
+			return true;
+	}
+	for (; i < count; i++) {
+		if (row[(size_t)i * 4 + 3])
+			return true;
+	}
+
+	return false;
+}
+
+/* Index of the first pixel in [x0, x1) with a non-zero alpha, or -1 */
+static int FindFirstAlpha(const uint8_t *row, int x0, int x1)
+{
+	int x = x0;
+
+	for (; x + 4 <= x1; x += 4) {
+		if (TransparentMask(row + (size_t)x * 4) != 0xFFFF)
+			break;
+	}
+	for (; x < x1; x++) {
+		if (row[(size_t)x * 4 + 3])
+			return x;
+	}
+
+	return -1;
+}
+
+/* Index of the last pixel in [x0, x1) with a non-zero alpha, or -1 */
+static int FindLastAlpha(const uint8_t *row, int x0, int x1)
+{
+	int x = x1;
+
+	for (; x - 4 >= x0; x -= 4) {
+		if (TransparentMask(row + (size_t)(x - 4) * 4) != 0xFFFF)
+			break;
+	}
+	for (x--; x >= x0; x--) {
+		if (row[(size_t)x * 4 + 3])
+			return x;
+	}
+
+	return -1;
+}
+
+FrameRect ScanAlphaBounds(const uint8_t *buffer, int width, int height, uint32_t linesize)
+{
+	int top = 0;
+	while (top < height && !AnyAlpha(buffer + (size_t)top * linesize, width))
+		top++;
+	if (top == height)
+		return FrameRect();
+
+	int bottom = height - 1;
+	while (bottom > top && !AnyAlpha(buffer + (size_t)bottom * linesize, width))
+		bottom--;
+
+	/* Every further row only has to be searched outside of the span
+	 * found so far */
+	int left = width;
+	int right = 0;
+
+	for (int y = top; y <= bottom; y++) {
+		const uint8_t *row = buffer + (size_t)y * linesize;
+
+		if (left > 0) {
+			const int first = FindFirstAlpha(row, 0, left);
+			if (first >= 0)
+				left = first;
+		}
+		if (right < width) {
+			const int last = FindLastAlpha(row, right, width);
+			if (last >= 0)
+				right = last + 1;
+		}
+		if (left == 0 && right == width)
+			break;
+	}
+
+	return FrameRect(left, top, right - left, bottom - top + 1);
+}
+
+static bool IsRectOpaque(const uint8_t *buffer, uint32_t linesize, const FrameRect &rect)
+{
+	const __m128i alpha_mask = _mm_set1_epi32((int)0xFF000000);
+
+	for (int y = rect.y; y < rect.Bottom(); y++) {
+		const uint8_t *row = buffer + (size_t)y * linesize;
+		int x = rect.x;
+
+		for (; x + 4 <= rect.Right(); x += 4) {
+			const __m128i px = _mm_loadu_si128((const __m128i *)(row + (size_t)x * 4));
+			const __m128i alpha = _mm_and_si128(px, alpha_mask);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alpha_mask)) != 0xFFFF)
+				return false;
+		}
+		for (; x < rect.Right(); x++) {
+			if (row[(size_t)x * 4 + 3] != 0xFF)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+FrameCoverage ScanFrameCoverage(const uint8_t *buffer, int width, int height, uint32_t linesize)
+{
+	FrameCoverage coverage;
+	coverage.bounds = ScanAlphaBounds(buffer, width, height, linesize);
+	coverage.opaque = !coverage.bounds.Empty() && IsRectOpaque(buffer, linesize, coverage.bounds);
+	return coverage;
+}
+
+static inline bool SameRect(const FrameRect &a, const FrameRect &b)
+{
+	return a.x == b.x && a.y == b.y && a.cx == b.cx && a.cy == b.cy;
+}
+
+FrameCoverage UpdateFrameCoverage(const FrameCoverage &previous, const uint8_t *buffer, int width, int height,
+				  uint32_t linesize, const DirtyRegion &dirty)
+{
+	/* Outside of the previous bounds everything was transparent, if one
+	 * dirty rect holds all of them nothing outside of dirty is visible */
+	bool covers_previous = previous.bounds.Empty();
+	FrameRect changed;
+
+	for (size_t i = 0; i < dirty.Count(); i++) {
+		const FrameRect rect = dirty[i].Clip(width, height);
+		if (rect.Empty())
+			continue;
+		if (rect.Contains(previous.bounds))
+			covers_previous = true;
+
+		FrameRect found = ScanAlphaBounds(buffer + (size_t)rect.y * linesize + (size_t)rect.x * 4, rect.cx,
+						  rect.cy, linesize);
+		found.x += rect.x;
+		found.y += rect.y;
+		changed = changed.Union(found);
+	}
+
+	FrameCoverage coverage;
+	coverage.bounds = covers_previous ? changed : previous.bounds.Union(changed);
+	if (coverage.bounds.Empty())
+		return coverage;
+
+	if (covers_previous) {
+		/* Between dirty rects there is only transparency */
+		for (size_t i = 0; i < dirty.Count(); i++) {
+			if (dirty[i].Contains(coverage.bounds)) {
+				coverage.opaque = IsRectOpaque(buffer, linesize, coverage.bounds);
+				break;
+			}
+		}
+	} else if (previous.opaque && SameRect(coverage.bounds, previous.bounds)) {
+		/* Only the dirty part of the bounds can have lost opacity */
+		coverage.opaque = true;
+		for (size_t i = 0; i < dirty.Count() && coverage.opaque; i++) {
+			const FrameRect rect = dirty[i].Clip(width, height).Intersect(coverage.bounds);
+			if (!rect.Empty())
+				coverage.opaque = IsRectOpaque(buffer, linesize, rect);
+		}
+	}
+
+	return coverage;
+}
+
+FrameAlpha FrameCoverage::Classify(int width, int height) const
+{
+	if (bounds.Empty())
+		return FrameAlpha::Transparent;
+	if (opaque && bounds.x == 0 && bounds.y == 0 && bounds.cx == width && bounds.cy == height)
+		return FrameAlpha::Opaque;
+	return FrameAlpha::Mixed;
+}
+
+/* ========================================================================= */
+
+static constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+
+static inline uint64_t Rotl64(uint64_t v, int r)
+{
+	return (v << r) | (v >> (64 - r));
+}
+
+static inline uint64_t HashRound(uint64_t acc, uint64_t input)
+{
+	return Rotl64(acc + input * PRIME64_2, 31) * PRIME64_1;
+}
+
+static inline uint64_t Read64(const uint8_t *ptr)
+{
+	uint64_t val;
+	memcpy(&val, ptr, sizeof(val));
+	return val;
+}
+
+/* xxHash64-style hash over a tile. The four independent accumulators keep
+ * the multipliers busy in parallel, this runs at several GB/s which is
+ * well beyond what a texture upload of the same pixels achieves. */
+static uint64_t HashTile(const uint8_t *buffer, uint32_t linesize, const FrameRect &tile)
+{
+	uint64_t acc[4] = {PRIME64_1 + PRIME64_2, PRIME64_2, 0, 0 - PRIME64_1};
+	const size_t row_size = (size_t)tile.cx * 4;
+
+	buffer += (size_t)tile.y * linesize + (size_t)tile.x * 4;
+
+	for (int y = 0; y < tile.cy; y++, buffer += linesize) {
+		size_t i = 0;
+
+		for (; i + 32 <= row_size; i += 32) {
+			acc[0] = HashRound(acc[0], Read64(buffer + i));
+			acc[1] = HashRound(acc[1], Read64(buffer + i + 8));
+			acc[2] = HashRound(acc[2], Read64(buffer + i + 16));
+			acc[3] = HashRound(acc[3], Read64(buffer + i + 24));
+		}
+		for (; i + 8 <= row_size; i += 8)
+			acc[0] = HashRound(acc[0], Read64(buffer + i));
+		if (i < row_size) {
+			uint32_t last;
+			memcpy(&last, buffer + i, sizeof(last));
+			acc[1] = HashRound(acc[1], last);
+		}
+	}
+
+	uint64_t hash = Rotl64(acc[0], 1) + Rotl64(acc[1], 7) + Rotl64(acc[2], 12) + Rotl64(acc[3], 18);
+	hash ^= hash >> 33;
+	hash *= PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= PRIME64_3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+FrameRect FrameTileHasher::TileRect(int tx, int ty) const
+{
+	return FrameRect(tx * TILE_SIZE, ty * TILE_SIZE, TILE_SIZE, TILE_SIZE).Clip(width, height);
+}
+
+bool FrameTileHasher::Filter(const uint8_t *buffer, int width_, int height_, const DirtyRegion &dirty,
+			     DirtyRegion &changed)
+{
+	const uint32_t linesize = (uint32_t)width_ * 4;
+
+	changed.Clear();
+
+	if (width_ != width || height_ != height) {
+		width = width_;
+		height = height_;
+		tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+		tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+		hashes.resize((size_t)tiles_x * tiles_y);
+		visited.assign(hashes.size(), 0);
+		pass = 0;
+
+		for (int ty = 0; ty < tiles_y; ty++) {
+			for (int tx = 0; tx < tiles_x; tx++)
+				hashes[(size_t)ty * tiles_x + tx] = HashTile(buffer, linesize, TileRect(tx, ty));
+		}
+
+		changed.Add(FrameRect(0, 0, width, height));
+		return true;
+	}
+
+	/* Dirty rects can share tiles, only hash each tile once per pass */
+	if (++pass == 0) {
+		visited.assign(visited.size(), 0);
+		pass = 1;
+	}
+
+	for (size_t i = 0; i < dirty.Count(); i++) {
+		const FrameRect &rect = dirty[i];
+		const int tx_end = (rect.Right() + TILE_SIZE - 1) / TILE_SIZE;
+		const int ty_end = (rect.Bottom() + TILE_SIZE - 1) / TILE_SIZE;
+
+		for (int ty = rect.y / TILE_SIZE; ty < ty_end; ty++) {
+			for (int tx = rect.x / TILE_SIZE; tx < tx_end; tx++) {
+				const size_t idx = (size_t)ty * tiles_x + tx;
+				if (visited[idx] == pass)
+					continue;
+				visited[idx] = pass;
+
+				const FrameRect tile = TileRect(tx, ty);
+				const uint64_t hash = HashTile(buffer, linesize, tile);
+				if (hash != hashes[idx]) {
+					hashes[idx] = hash;
+					changed.Add(tile);
+				}
+			}
+		}
+	}
+
+	return changed.Count() > 0;
+}
+
+/* ========================================================================= */
+
+bool FrameMailbox::CollectDamage(uint64_t since, uint64_t until, int width, int height, DirtyRegion &out) const
+{
+	out.Clear();
+
+	if (!since || since > until || until - since > HISTORY_SIZE)
+		return false;
+
+	for (uint64_t serial = since + 1; serial <= until; serial++) {
+		const HistoryEntry &entry = history[serial % HISTORY_SIZE];
+		if (entry.serial != serial || entry.width != width || entry.height != height)
+			return false;
+
+		out.Add(entry.dirty);
+	}
+
+	return true;
+}
+
+void FrameMailbox::Publish(const uint8_t *buffer, int width, int height, const DirtyRegion &dirty,
+			   const FrameCoverage &coverage)
+{
+	const uint64_t serial = ++last_serial;
+	const uint32_t linesize = (uint32_t)width * 4;
+
+	HistoryEntry &entry = history[serial % HISTORY_SIZE];
+	entry.serial = serial;
+	entry.width = width;
+	entry.height = height;
+	entry.dirty = dirty;
+
+	Frame &frame = slots[back];
+	DirtyRegion stale;
+
+	if (frame.width != width || frame.height != height ||
+	    !CollectDamage(frame.serial, serial, width, height, stale)) {
+		frame.data.resize((size_t)linesize * height);
+		frame.width = width;
+		frame.height = height;
+		memcpy(frame.data.data(), buffer, frame.data.size());
+	} else {
+		for (size_t i = 0; i < stale.Count(); i++)
+			CopyFrameRect(frame.data.data(), linesize, buffer, linesize, stale[i]);
+	}
+
+	frame.serial = serial;
+	frame.coverage = coverage;
+	frame.full_damage = !CollectDamage(consumed_serial.load(memory_order_acquire), serial, width, height,
+					   frame.damage);
+
+	back = middle.exchange(back | FRESH, memory_order_acq_rel) & INDEX_MASK;
+}
+
+const FrameMailbox::Frame *FrameMailbox::Current() const
+{
+	const Frame *frame = &slots[front];
+	return frame->serial ? frame : nullptr;
+}
+
+const FrameMailbox::Frame *FrameMailbox::Acquire()
+{
+	if ((middle.load(memory_order_relaxed) & FRESH) == 0)
+		return nullptr;
+
+	front = middle.exchange(front, memory_order_acq_rel) & INDEX_MASK;
+
+	const Frame *frame = &slots[front];
+	consumed_serial.store(frame->serial, memory_order_release);
+	return frame;
+}
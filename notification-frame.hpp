@@ -0,0 +1,216 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/* CPU-side helpers for the software (OnPaint) frame path. Everything in
+ * here works on tightly packed 32-bit BGRA frames as handed out by CEF. */
+
+struct FrameRect {
+	int x = 0;
+	int y = 0;
+	int cx = 0;
+	int cy = 0;
+
+	inline FrameRect() {}
+	inline FrameRect(int x_, int y_, int cx_, int cy_) : x(x_), y(y_), cx(cx_), cy(cy_) {}
+
+	inline bool Empty() const { return cx <= 0 || cy <= 0; }
+	inline int64_t Area() const { return Empty() ? 0 : (int64_t)cx * (int64_t)cy; }
+	inline int Right() const { return x + cx; }
+	inline int Bottom() const { return y + cy; }
+
+	/* Returns the rect clipped to a frame of width x height */
+	FrameRect Clip(int width, int height) const;
+	FrameRect Union(const FrameRect &other) const;
+	FrameRect Intersect(const FrameRect &other) const;
+	bool Touches(const FrameRect &other) const;
+	bool Contains(const FrameRect &other) const;
+};
+
+/* A small, allocation-free set of damaged rectangles. CEF can hand us dozens
+ * of tiny rects per paint; uploading each of them separately costs more than
+ * it saves, so rects that overlap or nearly overlap are merged, and once the
+ * set is full new rects are folded into whichever existing rect grows the
+ * least. */
+class DirtyRegion {
+public:
+	static constexpr size_t MAX_RECTS = 8;
+
+	inline void Clear() { count = 0; }
+	inline size_t Count() const { return count; }
+	inline const FrameRect &operator[](size_t idx) const { return rects[idx]; }
+
+	void Add(const FrameRect &rect);
+	void Add(const DirtyRegion &region);
+	int64_t Area() const;
+
+private:
+	FrameRect rects[MAX_RECTS];
+	size_t count = 0;
+
+	void MergeOverlapping(size_t idx);
+};
+
+/* Copies the pixels of rect from src to dst, placing them at dst_x/dst_y */
+void CopyFrameRect(uint8_t *dst, uint32_t dst_linesize, const uint8_t *src, uint32_t src_linesize,
+		   const FrameRect &rect, int dst_x, int dst_y);
+
+/* Copies the pixels of rect between two BGRA surfaces of the same size */
+static inline void CopyFrameRect(uint8_t *dst, uint32_t dst_linesize, const uint8_t *src, uint32_t src_linesize,
+				 const FrameRect &rect)
+{
+	CopyFrameRect(dst, dst_linesize, src, src_linesize, rect, rect.x, rect.y);
+}
+
+/* Zeroes the column right of and the row below a cx x cy area in the top-left
+ * of a larger surface, so that filtering at the area's edges blends towards
+ * transparency instead of whatever the rest of the surface holds */
+void ClearFrameBorder(uint8_t *dst, uint32_t linesize, int cx, int cy, int surface_cx, int surface_cy);
+
+enum class FrameAlpha : int {
+	Transparent,
+	Opaque,
+	Mixed,
+};
+
+/* Where a frame has visible content, and whether that content is solid */
+struct FrameCoverage {
+	/* Bounding rect of all pixels with a non-zero alpha */
+	FrameRect bounds;
+	/* Every pixel inside of bounds is fully opaque */
+	bool opaque = false;
+
+	/* Classification of the whole width x height frame */
+	FrameAlpha Classify(int width, int height) const;
+};
+
+/* Bounding rect of all pixels with a non-zero alpha, empty if the frame is
+ * fully transparent */
+FrameRect ScanAlphaBounds(const uint8_t *buffer, int width, int height, uint32_t linesize);
+
+/* Alpha bounds plus an early-out check whether everything inside of them is
+ * opaque, used to skip drawing empty frames and blending solid ones */
+FrameCoverage ScanFrameCoverage(const uint8_t *buffer, int width, int height, uint32_t linesize);
+
+/* Coverage of a frame that only changed inside dirty since a frame with the
+ * given coverage, found by scanning the dirty rects alone. Bounds that dirty
+ * may have shrunk are kept, so the result can be larger or less opaque than a
+ * full scan would find, never the other way round. */
+FrameCoverage UpdateFrameCoverage(const FrameCoverage &previous, const uint8_t *buffer, int width, int height,
+				  uint32_t linesize, const DirtyRegion &dirty);
+
+/* Keeps a hash of every fixed-size tile of the last frame. CEF regularly
+ * reports large areas as dirty when hardly anything changed (blinking
+ * carets, invisible animations, timers forcing a re-layout); hashing the
+ * reported tiles is far cheaper than uploading them, so paints are reduced
+ * to the tiles whose pixels actually differ. */
+class FrameTileHasher {
+public:
+	static constexpr int TILE_SIZE = 64;
+
+	/* Narrows dirty down to the tiles that really changed and stores the
+	 * result in changed. Returns false if no pixel changed at all. */
+	bool Filter(const uint8_t *buffer, int width, int height, const DirtyRegion &dirty, DirtyRegion &changed);
+
+	/* Forgets all hashes, the next frame is treated as entirely new */
+	inline void Reset() { width = height = 0; }
+
+private:
+	std::vector<uint64_t> hashes;
+	std::vector<uint32_t> visited;
+	uint32_t pass = 0;
+	int width = 0;
+	int height = 0;
+	int tiles_x = 0;
+	int tiles_y = 0;
+
+	FrameRect TileRect(int tx, int ty) const;
+};
+
+/* Triple-buffered single-producer/single-consumer hand-off of frames from the
+ * CEF paint thread to the graphics thread. Neither side ever waits on the
+ * other: the producer always has a free slot to write into, and the consumer
+ * only ever sees the newest complete frame, anything published in between is
+ * dropped.
+ *
+ * Every slot holds a complete copy of its frame, but the producer only copies
+ * what changed since that slot was last written. Each acquired frame also
+ * carries the region that changed since the frame the consumer took before
+ * it, so uploads can stay partial even when frames were dropped. */
+class FrameMailbox {
+public:
+	struct Frame {
+		std::vector<uint8_t> data;
+		int width = 0;
+		int height = 0;
+		uint64_t serial = 0;
+
+		/* Change relative to the previously acquired frame. When
+		 * full_damage is set the whole frame has to be uploaded. */
+		bool full_damage = true;
+		DirtyRegion damage;
+
+		FrameCoverage coverage;
+
+		inline uint32_t Linesize() const { return (uint32_t)width * 4; }
+	};
+
+	/* CEF thread */
+	void Publish(const uint8_t *buffer, int width, int height, const DirtyRegion &dirty,
+		     const FrameCoverage &coverage);
+
+	/* Graphics thread. Returns the newest frame published since the last
+	 * call, or nullptr if nothing new arrived. The frame stays valid until
+	 * the next call. */
+	const Frame *Acquire();
+
+	/* Graphics thread. The frame returned by the last Acquire, for when
+	 * the texture has to be rebuilt without a new paint. */
+	const Frame *Current() const;
+
+private:
+	static constexpr uint32_t FRESH = 4;
+	static constexpr uint32_t INDEX_MASK = 3;
+	static constexpr uint64_t HISTORY_SIZE = 16;
+
+	struct HistoryEntry {
+		uint64_t serial = 0;
+		int width = 0;
+		int height = 0;
+		DirtyRegion dirty;
+	};
+
+	Frame slots[3];
+	std::atomic<uint32_t> middle = 1;
+	std::atomic<uint64_t> consumed_serial = 0;
+
+	/* Owned by the producer */
+	uint32_t back = 0;
+	uint64_t last_serial = 0;
+	HistoryEntry history[HISTORY_SIZE];
+
+	/* Owned by the consumer */
+	uint32_t front = 2;
+
+	bool CollectDamage(uint64_t since, uint64_t until, int width, int height, DirtyRegion &out) const;
+};
@@ -0,0 +1,213 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "notification-future.hpp"
+#include <util/platform.h>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+struct CompletionState {
+	mutex state_mutex;
+	condition_variable resolved;
+	bool done = false;
+	bool ran = false;
+	function<void(bool)> callback;
+	uint64_t created = 0;
+	LatencyHistogram *latency = nullptr;
+	LatencyHistogram *waits = nullptr;
+
+	/* Promise copies and futures, the state goes back to the pool once
+	 * all of them are gone */
+	atomic<int> refs = 0;
+	/* Promise copies, the promise is resolved as dropped once all of them
+	 * are gone */
+	atomic<int> promises = 0;
+};
+
+static constexpr size_t MAX_IDLE_STATES = 64;
+
+static mutex pool_mutex;
+static vector<CompletionState *> idle_states;
+
+static CompletionState *AcquireState()
+{
+	{
+		lock_guard<mutex> lock(pool_mutex);
+		if (!idle_states.empty()) {
+			CompletionState *state = idle_states.back();
+			idle_states.pop_back();
+			return state;
+		}
+	}
+
+	return new CompletionState;
+}
+
+static void ReleaseState(CompletionState *state)
+{
+	if (--state->refs > 0)
+		return;
+
+	state->done = false;
+	state->ran = false;
+	state->callback = nullptr;
+
+	lock_guard<mutex> lock(pool_mutex);
+	if (idle_states.size() < MAX_IDLE_STATES)
+		idle_states.push_back(state);
+	else
+		delete state;
+}
+
+void NotificationFuturePoolClear()
+{
+	lock_guard<mutex> lock(pool_mutex);
+	for (CompletionState *state : idle_states)
+		delete state;
+	idle_states.clear();
+}
+
+void LatencyHistogram::Add(uint64_t ns)
+{
+	uint64_t us = ns / 1000;
+	size_t bucket = 0;
+	while (us && bucket < BUCKETS - 1) {
+		us >>= 1;
+		bucket++;
+	}
+
+	counts[bucket]++;
+}
+
+NotificationPromise::NotificationPromise(LatencyHistogram *latency, LatencyHistogram *waits) : state(AcquireState())
+{
+	state->created = os_gettime_ns();
+	state->latency = latency;
+	state->waits = waits;
+	state->refs = 1;
+	state->promises = 1;
+}
+
+NotificationPromise::NotificationPromise(const NotificationPromise &other) : state(other.state)
+{
+	state->refs++;
+	state->promises++;
+}
+
+NotificationPromise::~NotificationPromise()
+{
+	if (--state->promises == 0)
+		Resolve(false);
+	ReleaseState(state);
+}
+
+NotificationFuture NotificationPromise::GetFuture() const
+{
+	state->refs++;
+	return NotificationFuture(state);
+}
+
+void NotificationPromise::Resolve(bool ran)
+{
+	function<void(bool)> callback;
+	{
+		lock_guard<mutex> lock(state->state_mutex);
+		if (state->done)
+			return;
+
+		state->done = true;
+		state->ran = ran;
+		callback = std::move(state->callback);
+	}
+
+	state->resolved.notify_all();
+
+	if (state->latency)
+		state->latency->Add(os_gettime_ns() - state->created);
+	if (callback)
+		callback(ran);
+}
+
+NotificationFuture::NotificationFuture(CompletionState *state_) : state(state_) {}
+
+NotificationFuture::NotificationFuture(NotificationFuture &&other) noexcept : state(other.state)
+{
+	other.state = nullptr;
+}
+
+NotificationFuture &NotificationFuture::operator=(NotificationFuture &&other) noexcept
+{
+	if (this != &other) {
+		if (state)
+			ReleaseState(state);
+		state = other.state;
+		other.state = nullptr;
+	}
+	return *this;
+}
+
+NotificationFuture::~NotificationFuture()
+{
+	if (state)
+		ReleaseState(state);
+}
+
+bool NotificationFuture::Ready() const
+{
+	if (!state)
+		return false;
+
+	lock_guard<mutex> lock(state->state_mutex);
+	return state->done;
+}
+
+bool NotificationFuture::Wait()
+{
+	if (!state)
+		return false;
+
+	unique_lock<mutex> lock(state->state_mutex);
+	if (!state->done) {
+		const uint64_t start = os_gettime_ns();
+		state->resolved.wait(lock, [this]() { return state->done; });
+		if (state->waits)
+			state->waits->Add(os_gettime_ns() - start);
+	}
+
+	return state->ran;
+}
+
+void NotificationFuture::Then(function<void(bool)> callback)
+{
+	if (!state) {
+		callback(false);
+		return;
+	}
+
+	{
+		lock_guard<mutex> lock(state->state_mutex);
+		if (!state->done) {
+			state->callback = std::move(callback);
+			return;
+		}
+	}
+
+	callback(state->ran);
+}
@@ -0,0 +1,89 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Power-of-two buckets of microseconds, the first one counts everything
+ * below 1 us and the last one everything from 2^(BUCKETS - 2) us up */
+struct LatencyHistogram {
+	static constexpr size_t BUCKETS = 20;
+
+	std::atomic<uint64_t> counts[BUCKETS] = {};
+
+	void Add(uint64_t ns);
+};
+
+struct CompletionState;
+class NotificationFuture;
+
+/* Completion of a task queued to the CEF thread.
+ *
+ * The promise side is handed to the task and resolved when it ran, or when
+ * the last copy of it goes away without that (the task was dropped). The
+ * future side either blocks in Wait, for the few callers that really need
+ * the task to be done, or gets a callback through Then.
+ *
+ * Both share a state taken from a plugin-wide pool instead of creating a
+ * kernel event per call. The time from creation to resolve, which is what a
+ * blocking caller would wait, goes into the latency histogram, and the time
+ * callers actually spent blocked into the waits histogram. */
+class NotificationPromise {
+public:
+	NotificationPromise(LatencyHistogram *latency, LatencyHistogram *waits);
+	NotificationPromise(const NotificationPromise &other);
+	NotificationPromise &operator=(const NotificationPromise &) = delete;
+	~NotificationPromise();
+
+	NotificationFuture GetFuture() const;
+	void Resolve(bool ran);
+
+private:
+	CompletionState *state;
+};
+
+class NotificationFuture {
+public:
+	NotificationFuture() = default;
+	NotificationFuture(NotificationFuture &&other) noexcept;
+	NotificationFuture &operator=(NotificationFuture &&other) noexcept;
+	NotificationFuture(const NotificationFuture &) = delete;
+	NotificationFuture &operator=(const NotificationFuture &) = delete;
+	~NotificationFuture();
+
+	inline bool Valid() const { return state != nullptr; }
+	bool Ready() const;
+
+	/* Blocks until the promise is resolved, returns whether the task ran */
+	bool Wait();
+	/* Calls callback with whether the task ran once the promise is
+	 * resolved, on the resolving thread, or right away if it already is */
+	void Then(std::function<void(bool)> callback);
+
+private:
+	friend class NotificationPromise;
+	explicit NotificationFuture(CompletionState *state);
+
+	CompletionState *state = nullptr;
+};
+
+/* Frees the idle pooled states, at unload */
+void NotificationFuturePoolClear();
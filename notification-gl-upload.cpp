@@ -0,0 +1,405 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "notification-gl-upload.hpp"
+#include <util/base.h>
+#include <GL/glcorearb.h>
+#include <dlfcn.h>
+#include <string.h>
+#include <deque>
+#include <type_traits>
+
+using namespace std;
+
+/* The ring holds at least this many uploads of the largest size seen, so a
+ * frame never has to wait for the transfer of the one before it */
+static constexpr size_t RING_DEPTH = 3;
+static constexpr size_t RING_MIN_SIZE = 16 * 1024 * 1024;
+static constexpr size_t RING_MAX_SIZE = 256 * 1024 * 1024;
+static constexpr GLuint64 FENCE_TIMEOUT = 1000000000ULL;
+
+struct GLFunctions {
+	PFNGLGETERRORPROC GetError;
+	PFNGLGETINTEGERVPROC GetIntegerv;
+	PFNGLGETSTRINGPROC GetString;
+	PFNGLGETSTRINGIPROC GetStringi;
+	PFNGLGENBUFFERSPROC GenBuffers;
+	PFNGLDELETEBUFFERSPROC DeleteBuffers;
+	PFNGLBINDBUFFERPROC BindBuffer;
+	PFNGLBUFFERSTORAGEPROC BufferStorage;
+	PFNGLMAPBUFFERRANGEPROC MapBufferRange;
+	PFNGLBINDTEXTUREPROC BindTexture;
+	PFNGLPIXELSTOREIPROC PixelStorei;
+	PFNGLTEXSUBIMAGE2DPROC TexSubImage2D;
+	PFNGLFENCESYNCPROC FenceSync;
+	PFNGLCLIENTWAITSYNCPROC ClientWaitSync;
+	PFNGLDELETESYNCPROC DeleteSync;
+};
+
+struct InFlightUpload {
+	GLsync fence;
+	size_t begin;
+	size_t end;
+};
+
+enum class RingState {
+	Unknown,
+	Available,
+	Unavailable,
+};
+
+static RingState state = RingState::Unknown;
+static GLFunctions gl = {};
+
+static GLuint buffer = 0;
+static uint8_t *mapped = nullptr;
+static size_t capacity = 0;
+static size_t head = 0;
+static deque<InFlightUpload> in_flight;
+
+/* The upload between GLUploadBegin and GLUploadEnd */
+static size_t upload_begin = 0;
+static size_t upload_end = 0;
+static size_t cursor = 0;
+static GLint saved_texture = 0;
+static GLint saved_unpack_buffer = 0;
+static GLint saved_row_length = 0;
+static GLint saved_alignment = 0;
+
+static uint64_t uploads = 0;
+static uint64_t bytes_streamed = 0;
+static uint64_t stalls = 0;
+
+typedef void *(*GetProcAddressFunc)(const char *);
+
+/* libobs-opengl already has either EGL or GLX loaded, only look up the
+ * loader of whichever it is instead of linking against one of them */
+static GetProcAddressFunc FindGetProcAddress()
+{
+	static const char *const loaders[][2] = {
+		{"libEGL.so.1", "eglGetProcAddress"},
+		{"libGLX.so.0", "glXGetProcAddressARB"},
+		{"libGL.so.1", "glXGetProcAddressARB"},
+	};
+
+	for (const auto &loader : loaders) {
+		void *lib = dlopen(loader[0], RTLD_LAZY | RTLD_NOLOAD);
+		if (!lib)
+			continue;
+
+		void *func = dlsym(lib, loader[1]);
+		if (func)
+			return (GetProcAddressFunc)func;
+	}
+
+	return nullptr;
+}
+
+static bool LoadFunctions()
+{
+	GetProcAddressFunc get_proc = FindGetProcAddress();
+	if (!get_proc)
+		return false;
+
+	bool success = true;
+	auto load = [&](auto &func, const char *name) {
+		func = (typename std::remove_reference<decltype(func)>::type)get_proc(name);
+		if (!func)
+			success = false;
+	};
+
+	load(gl.GetError, "glGetError");
+	load(gl.GetIntegerv, "glGetIntegerv");
+	load(gl.GetString, "glGetString");
+	load(gl.GetStringi, "glGetStringi");
+	load(gl.GenBuffers, "glGenBuffers");
+	load(gl.DeleteBuffers, "glDeleteBuffers");
+	load(gl.BindBuffer, "glBindBuffer");
+	load(gl.BufferStorage, "glBufferStorage");
+	load(gl.MapBufferRange, "glMapBufferRange");
+	load(gl.BindTexture, "glBindTexture");
+	load(gl.PixelStorei, "glPixelStorei");
+	load(gl.TexSubImage2D, "glTexSubImage2D");
+	load(gl.FenceSync, "glFenceSync");
+	load(gl.ClientWaitSync, "glClientWaitSync");
+	load(gl.DeleteSync, "glDeleteSync");
+	return success;
+}
+
+static bool HasBufferStorage()
+{
+	GLint major = 0;
+	GLint minor = 0;
+	gl.GetIntegerv(GL_MAJOR_VERSION, &major);
+	gl.GetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major > 4 || (major == 4 && minor >= 4))
+		return true;
+
+	GLint count = 0;
+	gl.GetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++) {
+		const char *ext = (const char *)gl.GetStringi(GL_EXTENSIONS, (GLuint)i);
+		if (ext && strcmp(ext, "GL_ARB_buffer_storage") == 0)
+			return true;
+	}
+
+	return false;
+}
+
+static void WaitFence(GLsync fence)
+{
+	GLenum result = gl.ClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (result == GL_TIMEOUT_EXPIRED) {
+		stalls++;
+		do {
+			result = gl.ClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+		} while (result == GL_TIMEOUT_EXPIRED);
+	}
+
+	gl.DeleteSync(fence);
+}
+
+/* Drops the fences of transfers which already finished */
+static void ReapFences()
+{
+	while (!in_flight.empty()) {
+		const GLenum result = gl.ClientWaitSync(in_flight.front().fence, 0, 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+			break;
+
+		gl.DeleteSync(in_flight.front().fence);
+		in_flight.pop_front();
+	}
+}
+
+static void WaitAll()
+{
+	for (const InFlightUpload &upload : in_flight)
+		WaitFence(upload.fence);
+	in_flight.clear();
+}
+
+static void DestroyBuffer()
+{
+	WaitAll();
+
+	if (buffer)
+		gl.DeleteBuffers(1, &buffer);
+
+	buffer = 0;
+	mapped = nullptr;
+	capacity = 0;
+	head = 0;
+}
+
+/* Takes errors left behind by earlier calls off the context, so the next
+ * glGetError only reports our own. A lost context keeps reporting an error,
+ * hence the bound. */
+static void ClearErrors()
+{
+	int count = 0;
+	while (count++ < 16 && gl.GetError() != GL_NO_ERROR)
+		continue;
+}
+
+static bool CreateBuffer(size_t size)
+{
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	GLint previous = 0;
+	gl.GetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &previous);
+	ClearErrors();
+
+	gl.GenBuffers(1, &buffer);
+	gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+	gl.BufferStorage(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)size, nullptr, flags);
+	if (gl.GetError() == GL_NO_ERROR)
+		mapped = (uint8_t *)gl.MapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)size, flags);
+	gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, (GLuint)previous);
+
+	if (!mapped) {
+		gl.DeleteBuffers(1, &buffer);
+		buffer = 0;
+		return false;
+	}
+
+	capacity = size;
+	head = 0;
+	return true;
+}
+
+static bool Initialize()
+{
+	if (gs_get_device_type() != GS_DEVICE_OPENGL)
+		return false;
+
+	if (!LoadFunctions()) {
+		blog(LOG_INFO, "[spt-notification]: Could not load OpenGL functions, using regular texture uploads");
+		return false;
+	}
+
+	if (!HasBufferStorage()) {
+		blog(LOG_INFO, "[spt-notification]: ARB_buffer_storage is not supported, using regular texture uploads");
+		return false;
+	}
+
+	if (!CreateBuffer(RING_MIN_SIZE)) {
+		blog(LOG_WARNING, "[spt-notification]: Failed to map upload buffer, using regular texture uploads");
+		return false;
+	}
+
+	blog(LOG_INFO, "[spt-notification]: Streaming texture uploads through mapped buffers (%s)",
+	     (const char *)gl.GetString(GL_RENDERER));
+	return true;
+}
+
+bool GLUploadAvailable()
+{
+	if (state == RingState::Unknown)
+		state = Initialize() ? RingState::Available : RingState::Unavailable;
+
+	return state == RingState::Available;
+}
+
+/* Finds room for bytes after the last upload, wrapping around to the start
+ * of the ring, and waits for older transfers still reading from there */
+static size_t Reserve(size_t bytes)
+{
+	ReapFences();
+
+	const size_t offset = head + bytes > capacity ? 0 : head;
+	const size_t end = offset + bytes;
+
+	for (;;) {
+		bool overlaps = false;
+		for (const InFlightUpload &upload : in_flight) {
+			if (upload.begin < end && offset < upload.end) {
+				overlaps = true;
+				break;
+			}
+		}
+		if (!overlaps)
+			break;
+
+		WaitFence(in_flight.front().fence);
+		in_flight.pop_front();
+	}
+
+	return offset;
+}
+
+bool GLUploadBegin(gs_texture_t *tex, size_t bytes)
+{
+	if (!tex || !bytes || !GLUploadAvailable())
+		return false;
+
+	if (bytes * RING_DEPTH > capacity && capacity < RING_MAX_SIZE) {
+		const size_t size = min(max(bytes * RING_DEPTH, RING_MIN_SIZE), RING_MAX_SIZE);
+
+		DestroyBuffer();
+		if (!CreateBuffer(size)) {
+			blog(LOG_WARNING, "[spt-notification]: Failed to grow upload buffer, using regular texture uploads");
+			state = RingState::Unavailable;
+			return false;
+		}
+	}
+
+	if (bytes > capacity)
+		return false;
+
+	upload_begin = Reserve(bytes);
+	upload_end = upload_begin + bytes;
+	cursor = upload_begin;
+
+	gl.GetIntegerv(GL_TEXTURE_BINDING_2D, &saved_texture);
+	gl.GetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &saved_unpack_buffer);
+	gl.GetIntegerv(GL_UNPACK_ROW_LENGTH, &saved_row_length);
+	gl.GetIntegerv(GL_UNPACK_ALIGNMENT, &saved_alignment);
+
+	gl.BindTexture(GL_TEXTURE_2D, *(GLuint *)gs_texture_get_obj(tex));
+	gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+	gl.PixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	gl.PixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	return true;
+}
+
+static uint8_t *Allocate(const FrameRect &rect)
+{
+	const size_t bytes = (size_t)rect.cx * rect.cy * 4;
+	if (rect.Empty() || cursor + bytes > upload_end)
+		return nullptr;
+
+	uint8_t *ptr = mapped + cursor;
+	cursor += bytes;
+	return ptr;
+}
+
+static void Transfer(const FrameRect &dst, const uint8_t *ptr)
+{
+	gl.TexSubImage2D(GL_TEXTURE_2D, 0, dst.x, dst.y, dst.cx, dst.cy, GL_BGRA, GL_UNSIGNED_BYTE,
+			 (const void *)(uintptr_t)(ptr - mapped));
+}
+
+void GLUploadCopy(const uint8_t *src, uint32_t src_linesize, const FrameRect &rect, int dst_x, int dst_y)
+{
+	uint8_t *ptr = Allocate(rect);
+	if (!ptr)
+		return;
+
+	CopyFrameRect(ptr, (uint32_t)rect.cx * 4, src, src_linesize, rect, 0, 0);
+	Transfer(FrameRect(dst_x, dst_y, rect.cx, rect.cy), ptr);
+}
+
+void GLUploadClear(const FrameRect &rect)
+{
+	uint8_t *ptr = Allocate(rect);
+	if (!ptr)
+		return;
+
+	memset(ptr, 0, (size_t)rect.cx * rect.cy * 4);
+	Transfer(rect, ptr);
+}
+
+void GLUploadEnd()
+{
+	if (cursor > upload_begin) {
+		in_flight.push_back({gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), upload_begin, cursor});
+		head = cursor;
+		uploads++;
+		bytes_streamed += cursor - upload_begin;
+	}
+
+	gl.PixelStorei(GL_UNPACK_ALIGNMENT, saved_alignment);
+	gl.PixelStorei(GL_UNPACK_ROW_LENGTH, saved_row_length);
+	gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, (GLuint)saved_unpack_buffer);
+	gl.BindTexture(GL_TEXTURE_2D, (GLuint)saved_texture);
+}
+
+void GLUploadShutdown()
+{
+	if (state == RingState::Available) {
+		blog(LOG_INFO, "[spt-notification]: Streamed %llu uploads (%llu MB), waited on the GPU %llu times",
+		     (unsigned long long)uploads, (unsigned long long)(bytes_streamed / (1024 * 1024)),
+		     (unsigned long long)stalls);
+		DestroyBuffer();
+	}
+
+	state = RingState::Unknown;
+	uploads = 0;
+	bytes_streamed = 0;
+	stalls = 0;
+}
@@ -0,0 +1,52 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <graphics/graphics.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "notification-frame.hpp"
+
+/* Streaming texture uploads for the OpenGL renderer.
+ *
+ * Mapping a texture through libobs synchronizes with the GPU on every map and
+ * unmap. Instead, frames are copied into one plugin-wide ring of persistently
+ * mapped pixel unpack buffers and transferred into the texture from there, so
+ * the copy to the GPU overlaps with rendering. Parts of the ring are only
+ * reused once the fence of the transfer that read them has signaled.
+ *
+ * Requires GL 4.4 or ARB_buffer_storage (Mesa llvmpipe has both), otherwise
+ * GLUploadAvailable returns false and callers keep using gs_texture_map.
+ * Uploads go straight into the texture and bypass its libobs staging buffer,
+ * which therefore no longer matches the texture afterwards.
+ *
+ * All functions must be called inside the graphics context. */
+
+bool GLUploadAvailable();
+
+/* Starts an upload of at most bytes into tex, returns false if the ring
+ * cannot hold it */
+bool GLUploadBegin(gs_texture_t *tex, size_t bytes);
+/* Copies rect of a BGRA frame to dst_x/dst_y of the texture */
+void GLUploadCopy(const uint8_t *src, uint32_t src_linesize, const FrameRect &rect, int dst_x, int dst_y);
+/* Fills rect of the texture with transparent black */
+void GLUploadClear(const FrameRect &rect);
+void GLUploadEnd();
+
+void GLUploadShutdown();
@@ -0,0 +1,119 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "notification-governor.hpp"
+#include <obs.h>
+#include <util/base.h>
+#include <util/platform.h>
+#include <algorithm>
+
+using namespace std;
+
+static constexpr uint64_t SAMPLE_INTERVAL_NS = 1000000000ULL;
+/* Hidden sources take the first steps, program sources the last ones */
+static constexpr int MAX_LEVEL = GOVERNOR_MAX_STEP + 2;
+/* Calm samples in a row before the level goes down again */
+static constexpr int CALM_SAMPLES = 5;
+
+struct ThrottleStep {
+	int fps_divider;
+	float render_scale;
+};
+
+static constexpr ThrottleStep steps[GOVERNOR_MAX_STEP + 1] = {
+	{1, 1.0f},
+	{2, 1.0f},
+	{4, 1.0f},
+	{4, 0.75f},
+	{4, 0.5f},
+};
+
+static uint64_t last_sample_time = 0;
+static uint32_t last_lagged = 0;
+static uint32_t last_rendered = 0;
+static uint32_t last_skipped = 0;
+static uint32_t last_output = 0;
+static int level = 0;
+static int calm_samples = 0;
+
+int GovernorUpdate()
+{
+	const uint64_t now = os_gettime_ns();
+	if (now - last_sample_time < SAMPLE_INTERVAL_NS)
+		return level;
+
+	video_t *video = obs_get_video();
+	const uint32_t lagged = obs_get_lagged_frames();
+	const uint32_t rendered = obs_get_total_frames();
+	const uint32_t skipped = video ? video_output_get_skipped_frames(video) : 0;
+	const uint32_t output = video ? video_output_get_total_frames(video) : 0;
+	const uint64_t interval = video ? video_output_get_frame_time(video) : 0;
+	const uint64_t render_time = obs_get_average_frame_time_ns();
+
+	/* The first sample only sets the baseline */
+	const bool first = last_sample_time == 0;
+	const uint32_t new_lagged = lagged - last_lagged;
+	const uint32_t new_rendered = rendered - last_rendered;
+	const uint32_t new_skipped = skipped - last_skipped;
+	const uint32_t new_output = output - last_output;
+
+	last_sample_time = now;
+	last_lagged = lagged;
+	last_rendered = rendered;
+	last_skipped = skipped;
+	last_output = output;
+
+	if (first || !interval)
+		return level;
+
+	const bool slow = render_time * 10 > interval * 9;
+	const bool calm = !new_lagged && !new_skipped && render_time * 10 < interval * 6;
+
+	if (new_lagged || new_skipped || slow) {
+		calm_samples = 0;
+		if (level == MAX_LEVEL)
+			return level;
+
+		level++;
+		blog(LOG_INFO,
+		     "[spt-notification]: Lag governor raised to level %d: %u of %u frames lagged, "
+		     "%u of %u frames skipped, %.2f ms average render time",
+		     level, new_lagged, new_rendered, new_skipped, new_output, (double)render_time / 1000000.0);
+	} else if (calm && level > 0) {
+		if (++calm_samples < CALM_SAMPLES)
+			return level;
+
+		calm_samples = 0;
+		level--;
+		blog(LOG_INFO, "[spt-notification]: Lag governor lowered to level %d, %.2f ms average render time",
+		     level, (double)render_time / 1000000.0);
+	} else {
+		calm_samples = 0;
+	}
+
+	return level;
+}
+
+int GovernorFrameRateDivider(int step)
+{
+	return steps[clamp(step, 0, GOVERNOR_MAX_STEP)].fps_divider;
+}
+
+float GovernorRenderScale(int step)
+{
+	return steps[clamp(step, 0, GOVERNOR_MAX_STEP)].render_scale;
+}
@@ -0,0 +1,40 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+/* Plugin-wide render lag governor.
+ *
+ * Once a second it looks at the frames OBS lagged while rendering, the frames
+ * outputs skipped and the average time a frame took to render. Lagging,
+ * skipping or a render time close to the frame interval raises the pressure
+ * level by one, several calm seconds in a row lower it by one again. Sources
+ * that opted in map the level to a throttle step depending on where they
+ * are shown, so hidden sources back off first and program sources last.
+ *
+ * Must be called from the video tick. */
+
+static constexpr int GOVERNOR_MAX_STEP = 4;
+
+/* Samples OBS if a second has passed and returns the pressure level */
+int GovernorUpdate();
+
+/* What a throttle step does to a source */
+int GovernorFrameRateDivider(int step);
+float GovernorRenderScale(int step);
@@ -0,0 +1,161 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "notification-registry.hpp"
+#include "notification-atomic-ref.hpp"
+#include "spt-notification-source.hpp"
+#include <algorithm>
+#include <mutex>
+
+using namespace std;
+
+/* Only taken by writers, readers go through the published snapshot */
+static mutex registry_mutex;
+static AtomicRefPtr<RegistrySnapshot> registry;
+
+static void Index(unordered_multimap<string, size_t> &index, const string &key, size_t i)
+{
+	if (!key.empty())
+		index.emplace(key, i);
+}
+
+static void Publish(vector<RegistryEntry> &&entries)
+{
+	CefRefPtr<RegistrySnapshot> snapshot = new RegistrySnapshot();
+	snapshot->entries = std::move(entries);
+
+	for (size_t i = 0; i < snapshot->entries.size(); i++) {
+		const RegistryEntry &entry = snapshot->entries[i];
+		Index(snapshot->by_name, entry.name, i);
+		Index(snapshot->by_url, entry.url, i);
+		Index(snapshot->by_tag, entry.tag, i);
+	}
+
+	registry.Store(snapshot);
+}
+
+static vector<RegistryEntry> CopyEntries()
+{
+	CefRefPtr<RegistrySnapshot> current = registry.Load();
+	return current ? current->entries : vector<RegistryEntry>();
+}
+
+vector<const RegistryEntry *> RegistrySnapshot::Find(const string &name, const string &url, const string &tag) const
+{
+	/* Walk the index of the first key given and check the others */
+	const unordered_multimap<string, size_t> *index = nullptr;
+	const string *key = nullptr;
+	if (!tag.empty()) {
+		index = &by_tag;
+		key = &tag;
+	} else if (!name.empty()) {
+		index = &by_name;
+		key = &name;
+	} else if (!url.empty()) {
+		index = &by_url;
+		key = &url;
+	}
+
+	vector<size_t> found;
+	if (index) {
+		auto range = index->equal_range(*key);
+		for (auto it = range.first; it != range.second; ++it) {
+			const RegistryEntry &entry = entries[it->second];
+			if ((name.empty() || entry.name == name) && (url.empty() || entry.url == url) &&
+			    (tag.empty() || entry.tag == tag))
+				found.push_back(it->second);
+		}
+	} else {
+		for (size_t i = 0; i < entries.size(); i++)
+			found.push_back(i);
+	}
+
+	sort(found.begin(), found.end());
+
+	vector<const RegistryEntry *> matches;
+	matches.reserve(found.size());
+	for (size_t i : found)
+		matches.push_back(&entries[i]);
+	return matches;
+}
+
+CefRefPtr<RegistrySnapshot> GetNotificationRegistry()
+{
+	return registry.Load();
+}
+
+void NotificationRegistryAdd(NotificationSource *bs)
+{
+	RegistryEntry entry;
+	entry.bs = bs;
+	entry.weak = OBSGetWeakRef(bs->source);
+	const char *name = obs_source_get_name(bs->source);
+	entry.name = name ? name : "";
+	entry.url = bs->url;
+	entry.tag = bs->tag;
+
+	lock_guard<mutex> lock(registry_mutex);
+	vector<RegistryEntry> entries = CopyEntries();
+	entries.push_back(std::move(entry));
+	Publish(std::move(entries));
+}
+
+void NotificationRegistryRemove(NotificationSource *bs)
+{
+	lock_guard<mutex> lock(registry_mutex);
+	vector<RegistryEntry> entries = CopyEntries();
+	entries.erase(remove_if(entries.begin(), entries.end(),
+				[bs](const RegistryEntry &entry) { return entry.bs == bs; }),
+		      entries.end());
+	Publish(std::move(entries));
+}
+
+void NotificationRegistryRename(NotificationSource *bs, const char *name)
+{
+	if (!name)
+		name = "";
+
+	lock_guard<mutex> lock(registry_mutex);
+	vector<RegistryEntry> entries = CopyEntries();
+	for (RegistryEntry &entry : entries) {
+		if (entry.bs != bs)
+			continue;
+		if (entry.name == name)
+			return;
+
+		entry.name = name;
+		Publish(std::move(entries));
+		return;
+	}
+}
+
+void NotificationRegistrySetKeys(NotificationSource *bs, const string &url, const string &tag)
+{
+	lock_guard<mutex> lock(registry_mutex);
+	vector<RegistryEntry> entries = CopyEntries();
+	for (RegistryEntry &entry : entries) {
+		if (entry.bs != bs)
+			continue;
+		if (entry.url == url && entry.tag == tag)
+			return;
+
+		entry.url = url;
+		entry.tag = tag;
+		Publish(std::move(entries));
+		return;
+	}
+}
@@ -0,0 +1,63 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <obs.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cef-headers.hpp"
+
+struct NotificationSource;
+
+struct RegistryEntry {
+	NotificationSource *bs;
+	/* bs may only be touched while a strong reference taken through this
+	 * is held, which fails once the source is being destroyed */
+	OBSWeakSource weak;
+	std::string name;
+	std::string url;
+	std::string tag;
+};
+
+/* The live sources at one point in time. A snapshot never changes once it is
+ * published: sources being created, destroyed, renamed or retargeted publish
+ * a new copy, while broadcasters keep iterating the one they loaded. */
+class RegistrySnapshot : public CefBaseRefCounted {
+public:
+	std::vector<RegistryEntry> entries;
+	/* Entry indices, empty keys are not indexed */
+	std::unordered_multimap<std::string, size_t> by_name;
+	std::unordered_multimap<std::string, size_t> by_url;
+	std::unordered_multimap<std::string, size_t> by_tag;
+
+	/* Entries matching every key that is not empty */
+	std::vector<const RegistryEntry *> Find(const std::string &name, const std::string &url,
+						const std::string &tag) const;
+
+	IMPLEMENT_REFCOUNTING(RegistrySnapshot);
+};
+
+/* Never blocks, returns nullptr before the first source was created */
+CefRefPtr<RegistrySnapshot> GetNotificationRegistry();
+
+void NotificationRegistryAdd(NotificationSource *bs);
+void NotificationRegistryRemove(NotificationSource *bs);
+void NotificationRegistryRename(NotificationSource *bs, const char *name);
+void NotificationRegistrySetKeys(NotificationSource *bs, const std::string &url, const std::string &tag);
@@ -0,0 +1,218 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "notification-task-queue.hpp"
+#include "notification-app.hpp"
+#include "cef-headers.hpp"
+#include <util/base.h>
+#include <util/platform.h>
+#include <thread>
+
+using namespace std;
+
+#ifdef ENABLE_NOTIFICATION_QT_LOOP
+extern MessageObject messageObject;
+#endif
+
+/* Queued tasks, newest first */
+static atomic<QueuedTask *> pending = nullptr;
+/* Pushes are only taken between TaskQueueStart and TaskQueueStop, while CEF
+ * is running and a wake-up can be posted. A push counts itself in pushing
+ * before it checks, so TaskQueueStop can wait until the last one that got in
+ * is linked and then take it along. */
+static atomic<bool> accepting = false;
+static atomic<int> pushing = 0;
+/* A wake-up could not be posted even so, the next push has to post one
+ * although the list is not empty */
+static atomic<bool> stranded = false;
+/* Nodes handed back by the drain, taken all at once by producers */
+static atomic<QueuedTask *> recycled = nullptr;
+
+static TaskQueueStats stats;
+
+/* Nodes a producer took from the recycled list. Taking the whole list with a
+ * single exchange, instead of popping single nodes, keeps it free of ABA. */
+struct TaskCache {
+	QueuedTask *head = nullptr;
+
+	~TaskCache()
+	{
+		if (!head)
+			return;
+
+		QueuedTask *tail = head;
+		while (tail->next)
+			tail = tail->next;
+
+		QueuedTask *old = recycled.load(memory_order_relaxed);
+		do {
+			tail->next = old;
+		} while (!recycled.compare_exchange_weak(old, head, memory_order_release, memory_order_relaxed));
+	}
+};
+
+static thread_local TaskCache cache;
+
+static void Recycle(QueuedTask *task)
+{
+	task->Reset();
+
+	QueuedTask *old = recycled.load(memory_order_relaxed);
+	do {
+		task->next = old;
+	} while (!recycled.compare_exchange_weak(old, task, memory_order_release, memory_order_relaxed));
+}
+
+QueuedTask *TaskQueueAllocate()
+{
+	if (!cache.head)
+		cache.head = recycled.exchange(nullptr, memory_order_acquire);
+	if (!cache.head)
+		return new QueuedTask;
+
+	QueuedTask *task = cache.head;
+	cache.head = task->next;
+	task->next = nullptr;
+	return task;
+}
+
+void TaskQueueDrain()
+{
+	QueuedTask *list = pending.exchange(nullptr, memory_order_acquire);
+	if (!list)
+		return;
+
+	/* The list is newest first, tasks have to run in queueing order */
+	QueuedTask *ordered = nullptr;
+	uint64_t count = 0;
+	while (list) {
+		QueuedTask *next = list->next;
+		list->next = ordered;
+		ordered = list;
+		list = next;
+		count++;
+	}
+
+	const uint64_t now = os_gettime_ns();
+
+	size_t bucket = 0;
+	for (uint64_t n = count >> 1; n && bucket < TaskQueueStats::BATCH_BUCKETS - 1; n >>= 1)
+		bucket++;
+
+	stats.drains++;
+	stats.tasks += count;
+	stats.batch_sizes[bucket]++;
+	if (count > stats.max_batch)
+		stats.max_batch = count;
+
+	while (ordered) {
+		QueuedTask *task = ordered;
+		ordered = task->next;
+
+		stats.delay.Add(now - task->queued);
+		task->Run();
+		Recycle(task);
+	}
+}
+
+#ifdef ENABLE_NOTIFICATION_QT_LOOP
+/* CEF is pumped from the Qt event loop, so the drain goes straight onto the
+ * Qt event queue instead of making a round trip through CEF first */
+static bool PostDrain()
+{
+	return QMetaObject::invokeMethod(&messageObject, "ExecuteTask", Qt::QueuedConnection,
+					 Q_ARG(MessageTask, TaskQueueDrain));
+}
+#else
+class DrainTask : public CefTask {
+public:
+	virtual void Execute() override { TaskQueueDrain(); }
+
+	IMPLEMENT_REFCOUNTING(DrainTask);
+};
+
+static bool PostDrain()
+{
+	static CefRefPtr<CefTask> drain = new DrainTask();
+	return CefPostTask(TID_UI, drain);
+}
+#endif
+
+bool TaskQueuePush(QueuedTask *task)
+{
+	/* Turned away before it is linked in, nothing else is touched */
+	pushing.fetch_add(1, memory_order_seq_cst);
+	if (!accepting.load(memory_order_seq_cst)) {
+		pushing.fetch_sub(1, memory_order_release);
+		Recycle(task);
+		return false;
+	}
+
+	task->queued = os_gettime_ns();
+
+	QueuedTask *head = pending.load(memory_order_relaxed);
+	do {
+		task->next = head;
+	} while (!pending.compare_exchange_weak(head, task, memory_order_release, memory_order_relaxed));
+
+	/* Unless a wake-up is already on its way and will take this task
+	 * along. If one cannot be posted the task still stays queued, the
+	 * next push tries again and TaskQueueStop runs it at the latest. */
+	if (!head || (stranded.load(memory_order_relaxed) && stranded.exchange(false, memory_order_relaxed))) {
+		if (!PostDrain())
+			stranded.store(true, memory_order_relaxed);
+	}
+
+	pushing.fetch_sub(1, memory_order_release);
+	return true;
+}
+
+void TaskQueueStart()
+{
+	accepting.store(true, memory_order_seq_cst);
+}
+
+void TaskQueueStop()
+{
+	accepting.store(false, memory_order_seq_cst);
+	while (pushing.load(memory_order_seq_cst))
+		this_thread::yield();
+
+	TaskQueueDrain();
+}
+
+const TaskQueueStats &GetTaskQueueStats()
+{
+	return stats;
+}
+
+void TaskQueueShutdown()
+{
+	if (stats.drains)
+		blog(LOG_INFO, "[spt-notification]: Task queue ran %llu tasks in %llu batches (largest %llu)",
+		     (unsigned long long)stats.tasks.load(), (unsigned long long)stats.drains.load(),
+		     (unsigned long long)stats.max_batch.load());
+
+	for (QueuedTask *list : {cache.head, recycled.exchange(nullptr, memory_order_acquire)}) {
+		while (list) {
+			QueuedTask *next = list->next;
+			delete list;
+			list = next;
+		}
+	}
+	cache.head = nullptr;
+}
@@ -0,0 +1,123 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+
+#include "notification-future.hpp"
+
+/* A task waiting in the queue. Callables up to INLINE_SIZE bytes (a lambda
+ * holding a NotificationFunc, a browser ref and a promise) are stored in the
+ * node itself, larger ones fall back to the heap. Nodes are recycled, so
+ * queueing a small task does not allocate once the queue has warmed up. */
+class QueuedTask {
+public:
+	static constexpr size_t INLINE_SIZE = 64;
+
+	QueuedTask() = default;
+	QueuedTask(const QueuedTask &) = delete;
+	QueuedTask &operator=(const QueuedTask &) = delete;
+	inline ~QueuedTask() { Reset(); }
+
+	template<typename F> void Set(F &&func)
+	{
+		using T = std::decay_t<F>;
+
+		if constexpr (sizeof(T) <= INLINE_SIZE && alignof(T) <= alignof(std::max_align_t)) {
+			new (storage) T(std::forward<F>(func));
+			invoke = [](void *p) { (*static_cast<T *>(p))(); };
+			destroy = [](void *p) { static_cast<T *>(p)->~T(); };
+		} else {
+			*reinterpret_cast<T **>(storage) = new T(std::forward<F>(func));
+			invoke = [](void *p) { (**static_cast<T **>(p))(); };
+			destroy = [](void *p) { delete *static_cast<T **>(p); };
+		}
+	}
+
+	inline void Run() { invoke(storage); }
+
+	inline void Reset()
+	{
+		if (destroy)
+			destroy(storage);
+		invoke = nullptr;
+		destroy = nullptr;
+	}
+
+	QueuedTask *next = nullptr;
+	uint64_t queued = 0;
+
+private:
+	alignas(std::max_align_t) unsigned char storage[INLINE_SIZE];
+	void (*invoke)(void *) = nullptr;
+	void (*destroy)(void *) = nullptr;
+};
+
+/* Counters of the task queue, plugin-wide */
+struct TaskQueueStats {
+	/* Power-of-two buckets of tasks run per drain: 1, 2-3, 4-7, ... */
+	static constexpr size_t BATCH_BUCKETS = 12;
+
+	std::atomic<uint64_t> tasks = 0;
+	std::atomic<uint64_t> drains = 0;
+	std::atomic<uint64_t> max_batch = 0;
+	std::atomic<uint64_t> batch_sizes[BATCH_BUCKETS] = {};
+	/* Time from queueing a task to the drain that runs it */
+	LatencyHistogram delay;
+};
+
+/* Tasks for the CEF UI thread.
+ *
+ * Producers push onto a lock-free list from any thread. Only the push that
+ * finds the list empty posts a wake-up to CEF (or, with the Qt loop, to the
+ * Qt event queue), which then takes the whole list at once and runs it in
+ * queueing order. A burst of tasks thus costs one wake-up instead of one
+ * per task.
+ *
+ * Tasks are only taken while CEF is running, between TaskQueueStart and
+ * TaskQueueStop. Otherwise the task is dropped without running and false is
+ * returned. A task that was taken always runs. */
+QueuedTask *TaskQueueAllocate();
+bool TaskQueuePush(QueuedTask *task);
+
+template<typename F> inline bool QueueTask(F &&func)
+{
+	QueuedTask *task = TaskQueueAllocate();
+	task->Set(std::forward<F>(func));
+	return TaskQueuePush(task);
+}
+
+/* Runs everything queued right away, on the CEF UI thread */
+void TaskQueueDrain();
+
+/* Once CEF is initialized, on the CEF UI thread */
+void TaskQueueStart();
+/* Turns further tasks away and runs the ones still queued, on the CEF UI
+ * thread before CEF shuts down */
+void TaskQueueStop();
+
+const TaskQueueStats &GetTaskQueueStats();
+
+/* Frees the recycled nodes, at unload once CEF is shut down */
+void TaskQueueShutdown();
@@ -0,0 +1,129 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "notification-texture-pool.hpp"
+#include <util/base.h>
+#include <list>
+#include <mutex>
+
+using namespace std;
+
+struct PooledTexture {
+	gs_texture_t *tex;
+	gs_color_format format;
+	uint32_t cx;
+	uint32_t cy;
+	uint64_t bytes;
+};
+
+static mutex pool_mutex;
+static list<PooledTexture> idle_textures; /* most recently returned first */
+static uint64_t idle_bytes = 0;
+static uint64_t limit_bytes = 256ULL * 1024 * 1024;
+static uint64_t hits = 0;
+static uint64_t misses = 0;
+
+/* Rounds up to 64 for small sizes, and otherwise to a quarter of the largest
+ * power of two below the size, which wastes at most 25% per dimension */
+static uint32_t RoundSizeClass(uint32_t size)
+{
+	if (size <= 64)
+		return 64;
+
+	uint32_t step = 1;
+	while (step <= size / 2)
+		step <<= 1;
+	step /= 4;
+
+	return (size + step - 1) / step * step;
+}
+
+static void TrimIdleTextures()
+{
+	while (idle_bytes > limit_bytes && !idle_textures.empty()) {
+		PooledTexture &oldest = idle_textures.back();
+		gs_texture_destroy(oldest.tex);
+		idle_bytes -= oldest.bytes;
+		idle_textures.pop_back();
+	}
+}
+
+gs_texture_t *TexturePoolAcquire(gs_color_format format, uint32_t cx, uint32_t cy)
+{
+	if (!cx || !cy)
+		return nullptr;
+
+	const uint32_t class_cx = RoundSizeClass(cx);
+	const uint32_t class_cy = RoundSizeClass(cy);
+
+	{
+		lock_guard<mutex> lock(pool_mutex);
+
+		for (auto it = idle_textures.begin(); it != idle_textures.end(); ++it) {
+			if (it->format == format && it->cx == class_cx && it->cy == class_cy) {
+				gs_texture_t *tex = it->tex;
+				idle_bytes -= it->bytes;
+				idle_textures.erase(it);
+				hits++;
+				return tex;
+			}
+		}
+
+		misses++;
+	}
+
+	return gs_texture_create(class_cx, class_cy, format, 1, nullptr, GS_DYNAMIC);
+}
+
+void TexturePoolRelease(gs_texture_t *tex)
+{
+	if (!tex)
+		return;
+
+	PooledTexture entry;
+	entry.tex = tex;
+	entry.format = gs_texture_get_color_format(tex);
+	entry.cx = gs_texture_get_width(tex);
+	entry.cy = gs_texture_get_height(tex);
+	entry.bytes = (uint64_t)entry.cx * entry.cy * gs_get_format_bpp(entry.format) / 8;
+
+	lock_guard<mutex> lock(pool_mutex);
+	idle_textures.push_front(entry);
+	idle_bytes += entry.bytes;
+	TrimIdleTextures();
+}
+
+void TexturePoolClear()
+{
+	lock_guard<mutex> lock(pool_mutex);
+
+	if (hits || misses)
+		blog(LOG_INFO, "[spt-notification]: Texture pool reused %llu of %llu textures",
+		     (unsigned long long)hits, (unsigned long long)(hits + misses));
+
+	for (PooledTexture &entry : idle_textures)
+		gs_texture_destroy(entry.tex);
+
+	idle_textures.clear();
+	idle_bytes = 0;
+}
+
+void TexturePoolSetLimit(uint64_t bytes)
+{
+	lock_guard<mutex> lock(pool_mutex);
+	limit_bytes = bytes;
+}
@@ -0,0 +1,39 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <graphics/graphics.h>
+#include <stdint.h>
+
+/* Plugin-wide pool of dynamic textures shared by all notification sources.
+ *
+ * Sizes are rounded up to a small set of size classes so that a source which
+ * is resized, reloaded or recreated can reuse a texture another source (or
+ * itself) just gave back instead of going through the driver. Textures may
+ * therefore be larger than what was asked for, callers only use the top-left
+ * part of them.
+ *
+ * Idle textures are kept until they exceed the memory limit, then the least
+ * recently returned ones are destroyed. All functions except
+ * TexturePoolSetLimit must be called inside the graphics context. */
+
+gs_texture_t *TexturePoolAcquire(gs_color_format format, uint32_t cx, uint32_t cy);
+void TexturePoolRelease(gs_texture_t *tex);
+void TexturePoolClear();
+
+void TexturePoolSetLimit(uint64_t bytes);
@@ -33,6 +33,8 @@
 #include "spt-notification-source.hpp"
 #include "notification-scheme.hpp"
 #include "notification-app.hpp"
+#include "notification-task-queue.hpp"
+#include "notification-texture-pool.hpp"
 #include "notification-version.h"
 
 #include "cef-headers.hpp"
@@ -55,6 +57,10 @@
 #include <QThread>
 #endif
 
+#ifdef ENABLE_NOTIFICATION_GL_UPLOAD
+#include "notification-gl-upload.hpp"
+#endif
+
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("spt-notification", "en-US")
 MODULE_EXPORT const char *obs_module_description(void)
@@ -77,34 +83,9 @@ bool hwaccel = false;
 
 /* ========================================================================= */
 
-#ifdef ENABLE_NOTIFICATION_QT_LOOP
-extern MessageObject messageObject;
-#endif
-
-class NotificationTask : public CefTask {
-public:
-	std::function<void()> task;
-
-	inline NotificationTask(std::function<void()> task_) : task(task_) {}
-	virtual void Execute() override
-	{
-#ifdef ENABLE_NOTIFICATION_QT_LOOP
-		/* you have to put the tasks on the Qt event queue after this
-		 * call otherwise the CEF message pump may stop functioning
-		 * correctly, it's only supposed to take 10ms max */
-		QMetaObject::invokeMethod(&messageObject, "ExecuteTask", Qt::QueuedConnection,
-					  Q_ARG(MessageTask, task));
-#else
-		task();
-#endif
-	}
-
-	IMPLEMENT_REFCOUNTING(NotificationTask);
-};
-
 bool QueueCEFTask(std::function<void()> task)
 {
-	return CefPostTask(TID_UI, CefRefPtr<NotificationTask>(new NotificationTask(task)));
+	return QueueTask(std::move(task));
 }
 
 /* ========================================================================= */
@@ -134,7 +115,32 @@ static void notification_source_get_defaults(obs_data_t *settings)
 	obs_data_set_default_bool(settings, "restart_when_active", false);
 	obs_data_set_default_int(settings, "webpage_control_level", (int)DEFAULT_CONTROL_LEVEL);
 	obs_data_set_default_string(settings, "css", default_css);
+	obs_data_set_default_string(settings, "tag", "");
 	obs_data_set_default_bool(settings, "reroute_audio", false);
+	obs_data_set_default_int(settings, "partial_upload_threshold", 50);
+	obs_data_set_default_bool(settings, "change_detection", true);
+	obs_data_set_default_bool(settings, "trim_transparent", true);
+	obs_data_set_default_bool(settings, "adaptive_fps", false);
+	obs_data_set_default_int(settings, "adaptive_idle_frames", 60);
+	obs_data_set_default_int(settings, "adaptive_min_fps", 5);
+	obs_data_set_default_int(settings, "adaptive_max_fps", 0);
+	obs_data_set_default_bool(settings, "idle_freeze", false);
+	obs_data_set_default_int(settings, "idle_freeze_seconds", 30);
+	obs_data_set_default_bool(settings, "external_begin_frame", false);
+	obs_data_set_default_int(settings, "begin_frame_divider", 1);
+	obs_data_set_default_bool(settings, "frame_rate_tiers", false);
+	obs_data_set_default_int(settings, "preview_fps", 15);
+	obs_data_set_default_int(settings, "hidden_fps", 1);
+	obs_data_set_default_bool(settings, "visibility_culling", false);
+	obs_data_set_default_bool(settings, "auto_resolution", false);
+	obs_data_set_default_bool(settings, "lag_governor", false);
+	obs_data_set_default_double(settings, "render_scale", 1.0);
+	obs_data_set_default_int(settings, "render_scale_filter", OBS_SCALE_BILINEAR);
+	obs_data_set_default_int(settings, "viewport_mode", (int)ViewportMode::Full);
+	obs_data_set_default_int(settings, "viewport_x", 0);
+	obs_data_set_default_int(settings, "viewport_y", 0);
+	obs_data_set_default_int(settings, "viewport_width", 0);
+	obs_data_set_default_int(settings, "viewport_height", 0);
 }
 
 static bool is_local_file_modified(obs_properties_t *props, obs_property_t *, obs_data_t *settings)
@@ -157,6 +163,17 @@ static bool is_fps_custom(obs_properties_t *props, obs_property_t *, obs_data_t
 	return true;
 }
 
+static bool is_viewport_manual(obs_properties_t *props, obs_property_t *, obs_data_t *settings)
+{
+	bool enabled = obs_data_get_int(settings, "viewport_mode") == (int)ViewportMode::Manual;
+	obs_property_set_visible(obs_properties_get(props, "viewport_x"), enabled);
+	obs_property_set_visible(obs_properties_get(props, "viewport_y"), enabled);
+	obs_property_set_visible(obs_properties_get(props, "viewport_width"), enabled);
+	obs_property_set_visible(obs_properties_get(props, "viewport_height"), enabled);
+
+	return true;
+}
+
 static obs_properties_t *notification_source_get_properties(void *data)
 {
    UNUSED_PARAMETER(data);
@@ -166,6 +183,9 @@ static obs_properties_t *notification_source_get_properties(void *data)
 
 	obs_properties_add_bool(props, "reroute_audio", obs_module_text("RerouteAudio"));
 
+	obs_property_t *tag = obs_properties_add_text(props, "tag", obs_module_text("Tag"), OBS_TEXT_DEFAULT);
+	obs_property_set_long_description(tag, obs_module_text("Tag.Description"));
+
 	obs_property_t *fps_set = obs_properties_add_bool(props, "fps_custom", obs_module_text("CustomFrameRate"));
 	obs_property_set_modified_callback(fps_set, is_fps_custom);
 
@@ -173,6 +193,73 @@ static obs_properties_t *notification_source_get_properties(void *data)
 	obs_property_set_enabled(fps_set, false);
 #endif
 
+	obs_properties_t *perf = obs_properties_create();
+	obs_property_t *p = obs_properties_add_int_slider(perf, "partial_upload_threshold",
+							  obs_module_text("PartialUploadThreshold"), 0, 100, 5);
+	obs_property_int_set_suffix(p, "%");
+	obs_property_set_long_description(p, obs_module_text("PartialUploadThreshold.Description"));
+	p = obs_properties_add_bool(perf, "change_detection", obs_module_text("ChangeDetection"));
+	obs_property_set_long_description(p, obs_module_text("ChangeDetection.Description"));
+	p = obs_properties_add_bool(perf, "trim_transparent", obs_module_text("TrimTransparent"));
+	obs_property_set_long_description(p, obs_module_text("TrimTransparent.Description"));
+	p = obs_properties_add_bool(perf, "adaptive_fps", obs_module_text("AdaptiveFPS"));
+	obs_property_set_long_description(p, obs_module_text("AdaptiveFPS.Description"));
+	p = obs_properties_add_int(perf, "adaptive_idle_frames", obs_module_text("AdaptiveFPS.IdleFrames"), 1, 3600, 1);
+	obs_property_set_long_description(p, obs_module_text("AdaptiveFPS.IdleFrames.Description"));
+	obs_properties_add_int(perf, "adaptive_min_fps", obs_module_text("AdaptiveFPS.MinFPS"), 1, 60, 1);
+	p = obs_properties_add_int(perf, "adaptive_max_fps", obs_module_text("AdaptiveFPS.MaxFPS"), 0, 240, 1);
+	obs_property_set_long_description(p, obs_module_text("AdaptiveFPS.MaxFPS.Description"));
+#if ENABLE_WASHIDDEN
+	p = obs_properties_add_bool(perf, "idle_freeze", obs_module_text("IdleFreeze"));
+	obs_property_set_long_description(p, obs_module_text("IdleFreeze.Description"));
+	p = obs_properties_add_int(perf, "idle_freeze_seconds", obs_module_text("IdleFreeze.Seconds"), 1, 3600, 1);
+	obs_property_int_set_suffix(p, " s");
+#endif
+	p = obs_properties_add_bool(perf, "frame_rate_tiers", obs_module_text("FrameRateTiers"));
+	obs_property_set_long_description(p, obs_module_text("FrameRateTiers.Description"));
+	obs_properties_add_int(perf, "preview_fps", obs_module_text("FrameRateTiers.PreviewFPS"), 1, 240, 1);
+	obs_properties_add_int(perf, "hidden_fps", obs_module_text("FrameRateTiers.HiddenFPS"), 1, 60, 1);
+	p = obs_properties_add_bool(perf, "visibility_culling", obs_module_text("VisibilityCulling"));
+	obs_property_set_long_description(p, obs_module_text("VisibilityCulling.Description"));
+	p = obs_properties_add_bool(perf, "auto_resolution", obs_module_text("AutoResolution"));
+	obs_property_set_long_description(p, obs_module_text("AutoResolution.Description"));
+	p = obs_properties_add_bool(perf, "lag_governor", obs_module_text("LagGovernor"));
+	obs_property_set_long_description(p, obs_module_text("LagGovernor.Description"));
+	p = obs_properties_add_list(perf, "render_scale", obs_module_text("RenderScale"), OBS_COMBO_TYPE_LIST,
+				    OBS_COMBO_FORMAT_FLOAT);
+	obs_property_list_add_float(p, "100%", 1.0);
+	obs_property_list_add_float(p, "75%", 0.75);
+	obs_property_list_add_float(p, "66.7%", 0.667);
+	obs_property_list_add_float(p, "50%", 0.5);
+	obs_property_set_long_description(p, obs_module_text("RenderScale.Description"));
+	p = obs_properties_add_list(perf, "render_scale_filter", obs_module_text("RenderScale.Filter"),
+				    OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(p, obs_module_text("RenderScale.Filter.Bilinear"), OBS_SCALE_BILINEAR);
+	obs_property_list_add_int(p, obs_module_text("RenderScale.Filter.Bicubic"), OBS_SCALE_BICUBIC);
+	obs_property_list_add_int(p, obs_module_text("RenderScale.Filter.Lanczos"), OBS_SCALE_LANCZOS);
+#if CHROME_VERSION_BUILD > 4183
+	p = obs_properties_add_list(perf, "viewport_mode", obs_module_text("Viewport"), OBS_COMBO_TYPE_LIST,
+				    OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(p, obs_module_text("Viewport.Full"), (int)ViewportMode::Full);
+	obs_property_list_add_int(p, obs_module_text("Viewport.Manual"), (int)ViewportMode::Manual);
+	obs_property_list_add_int(p, obs_module_text("Viewport.SceneCrop"), (int)ViewportMode::SceneCrop);
+	obs_property_set_long_description(p, obs_module_text("Viewport.Description"));
+	obs_property_set_modified_callback(p, is_viewport_manual);
+	obs_properties_add_int(perf, "viewport_x", obs_module_text("Viewport.X"), 0, 8192, 1);
+	obs_properties_add_int(perf, "viewport_y", obs_module_text("Viewport.Y"), 0, 8192, 1);
+	p = obs_properties_add_int(perf, "viewport_width", obs_module_text("Viewport.Width"), 0, 8192, 1);
+	obs_property_set_long_description(p, obs_module_text("Viewport.Size.Description"));
+	p = obs_properties_add_int(perf, "viewport_height", obs_module_text("Viewport.Height"), 0, 8192, 1);
+	obs_property_set_long_description(p, obs_module_text("Viewport.Size.Description"));
+#endif
+#ifndef ENABLE_BROWSER_SHARED_TEXTURE
+	p = obs_properties_add_bool(perf, "external_begin_frame", obs_module_text("ExternalBeginFrame"));
+	obs_property_set_long_description(p, obs_module_text("ExternalBeginFrame.Description"));
+	p = obs_properties_add_int(perf, "begin_frame_divider", obs_module_text("ExternalBeginFrame.Divider"), 1, 10, 1);
+	obs_property_set_long_description(p, obs_module_text("ExternalBeginFrame.Divider.Description"));
+#endif
+	obs_properties_add_group(props, "performance", obs_module_text("Performance"), OBS_GROUP_NORMAL, perf);
+
 	obs_properties_add_button(props, "refreshnocache", obs_module_text("RefreshNoCache"),
 				  [](obs_properties_t *, obs_property_t *, void *data) {
 					  static_cast<NotificationSource *>(data)->Refresh();
@@ -347,6 +434,7 @@ static void NotificationInit(void)
 	 * CEF builds which do not support file:// URLs */
 	CefRegisterSchemeHandlerFactory("http", "absolute", new NotificationSchemeHandlerFactory());
 #endif
+	TaskQueueStart();
 	os_event_signal(cef_started_event);
 }
 
@@ -355,9 +443,8 @@ static void NotificationShutdown(void)
 #if !ENABLE_LOCAL_FILE_URL_SCHEME
 	CefClearSchemeHandlerFactories();
 #endif
+	TaskQueueStop();
 #ifdef ENABLE_NOTIFICATION_QT_LOOP
-	while (messageObject.ExecuteNextNotificationTask())
-		;
 	CefDoMessageLoopWork();
 #endif
 	CefShutdown();
@@ -467,7 +554,10 @@ void RegisterNotificationSource()
 
 /* ========================================================================= */
 
-extern void DispatchJSEvent(std::string eventName, std::string jsonString, NotificationSource *notification = nullptr);
+extern void DispatchJSEvent(std::string eventName, std::string jsonString, NotificationSource *notification = nullptr,
+			    bool activity = true);
+extern void DispatchJSEventTo(std::string eventName, std::string jsonString, const std::string &name,
+			      const std::string &url, const std::string &tag);
 
 static void handle_obs_frontend_event(enum obs_frontend_event event, void *)
 {
@@ -690,8 +780,9 @@ bool obs_module_load(void)
 	RegisterNotificationSource();
 	obs_frontend_add_event_callback(handle_obs_frontend_event, nullptr);
 
+	OBSDataAutoRelease private_data = obs_get_private_data();
+
 #ifdef ENABLE_BROWSER_SHARED_TEXTURE
-   OBSDataAutoRelease private_data = obs_get_private_data();
    hwaccel = obs_data_get_bool(private_data, "BrowserHWAccel");
 
    if (hwaccel) {
@@ -699,6 +790,9 @@ bool obs_module_load(void)
    }
 #endif
 
+	obs_data_set_default_int(private_data, "NotificationTexturePoolMB", 256);
+	TexturePoolSetLimit((uint64_t)obs_data_get_int(private_data, "NotificationTexturePoolMB") * 1024 * 1024);
+
 #if defined(__APPLE__) && CHROME_VERSION_BUILD < 4183
 	// Make sure CEF malloc hijacking happens early in the process
 	spt_notification_initialize();
@@ -721,7 +815,14 @@ void obs_module_post_load(void)
       OBSDataAutoRelease event_data = obs_data_get_obj(request_data, "event_data");
 		const char *event_data_string = event_data ? obs_data_get_json(event_data) : "{}";
 
-		DispatchJSEvent(event_name, event_data_string, nullptr);
+		/* Optional keys narrow the event down to matching sources.
+		 * Unlike the OBS state broadcasts, it wakes the pages it
+		 * reaches, with or without keys. */
+		const std::string source_name = obs_data_get_string(request_data, "source_name");
+		const std::string source_url = obs_data_get_string(request_data, "source_url");
+		const std::string source_tag = obs_data_get_string(request_data, "source_tag");
+
+		DispatchJSEventTo(event_name, event_data_string, source_name, source_url, source_tag);
 	};
 
 	if (!obs_websocket_vendor_register_request(vendor, "emit_event", emit_event_request_cb, nullptr))
@@ -730,6 +831,13 @@ void obs_module_post_load(void)
 
 void obs_module_unload(void)
 {
+	obs_enter_graphics();
+	TexturePoolClear();
+#ifdef ENABLE_NOTIFICATION_GL_UPLOAD
+	GLUploadShutdown();
+#endif
+	obs_leave_graphics();
+
 #ifdef ENABLE_NOTIFICATION_QT_LOOP
 	NotificationShutdown();
 #else
@@ -741,5 +849,7 @@ void obs_module_unload(void)
 	}
 #endif
 
+	TaskQueueShutdown();
+	NotificationFuturePoolClear();
 	os_event_destroy(cef_started_event);
 }
@@ -18,12 +18,20 @@
 
 #include "spt-notification-source.hpp"
 #include "notification-client.hpp"
+#include "notification-culling.hpp"
+#include "notification-governor.hpp"
+#include "notification-registry.hpp"
 #include "notification-scheme.hpp"
+#include "notification-task-queue.hpp"
 #include "wide-string.hpp"
 #include <nlohmann/json.hpp>
 #include <util/threading.h>
+#include <util/platform.h>
 #include <QApplication>
 #include <util/dstr.h>
+#include <graphics/vec2.h>
+#include <algorithm>
+#include <cmath>
 #include <functional>
 #include <thread>
 #include <mutex>
@@ -37,13 +45,14 @@
 #include <QThread>
 #endif
 
+#ifdef ENABLE_NOTIFICATION_GL_UPLOAD
+#include "notification-gl-upload.hpp"
+#endif
+
 using namespace std;
 
 extern bool QueueCEFTask(std::function<void()> task);
 
-static mutex notification_list_mutex;
-static NotificationSource *first_notification = nullptr;
-
 static void SendNotificationVisibility(CefRefPtr<CefBrowser> notification, bool isVisible)
 {
 	if (!notification)
@@ -65,7 +74,13 @@ static void SendNotificationVisibility(CefRefPtr<CefBrowser> notification, bool
 	SendNotificationProcessMessage(notification, PID_RENDERER, msg);
 }
 
-void DispatchJSEvent(std::string eventName, std::string jsonString, NotificationSource *notification = nullptr);
+void DispatchJSEvent(std::string eventName, std::string jsonString, NotificationSource *notification = nullptr,
+		     bool activity = true);
+
+static void SourceRenamed(void *data, calldata_t *calldata)
+{
+	NotificationRegistryRename(static_cast<NotificationSource *>(data), calldata_string(calldata, "new_name"));
+}
 
 NotificationSource::NotificationSource(obs_data_t *, obs_source_t *source_) : source(source_)
 {
@@ -91,19 +106,26 @@ NotificationSource::NotificationSource(obs_data_t *, obs_source_t *source_) : so
 		DispatchJSEvent(eventName, jsonString, (NotificationSource *)p);
 	};
 
+	auto statsFunction = [](void *p, calldata_t *calldata) {
+		std::string json = static_cast<NotificationSource *>(p)->GetStatsJson();
+		calldata_set_string(calldata, "json", json.c_str());
+	};
+
+	auto emptyFunction = [](void *p, calldata_t *calldata) {
+		calldata_set_bool(calldata, "empty", static_cast<NotificationSource *>(p)->IsEmpty());
+	};
+
 	proc_handler_t *ph = obs_source_get_proc_handler(source);
 	proc_handler_add(ph, "void javascript_event(string eventName, string jsonString)", jsEventFunction,
 			 (void *)this);
+	proc_handler_add(ph, "void get_stats(out string json)", statsFunction, (void *)this);
+	proc_handler_add(ph, "void is_empty(out bool empty)", emptyFunction, (void *)this);
 
 	/* defer update */
 	obs_source_update(source, nullptr);
 
-	lock_guard<mutex> lock(notification_list_mutex);
-	p_prev_next = &first_notification;
-	next = first_notification;
-	if (first_notification)
-		first_notification->p_prev_next = &next;
-	first_notification = this;
+	signal_handler_connect(obs_source_get_signal_handler(source), "rename", SourceRenamed, this);
+	NotificationRegistryAdd(this);
 }
 
 static void ActuallyCloseNotification(CefRefPtr<CefBrowser> cefNotification)
@@ -125,8 +147,9 @@ static void ActuallyCloseNotification(CefRefPtr<CefBrowser> cefNotification)
 
 NotificationSource::~NotificationSource()
 {
-	if (cefNotification)
-		ActuallyCloseNotification(cefNotification);
+	CefRefPtr<CefBrowser> notification = GetNotification();
+	if (notification)
+		ActuallyCloseNotification(notification);
 }
 
 void NotificationSource::Destroy()
@@ -134,10 +157,8 @@ void NotificationSource::Destroy()
 	destroying = true;
 	DestroyTextures();
 
-	lock_guard<mutex> lock(notification_list_mutex);
-	if (next)
-		next->p_prev_next = p_prev_next;
-	*p_prev_next = next;
+	signal_handler_disconnect(obs_source_get_signal_handler(source), "rename", SourceRenamed, this);
+	NotificationRegistryRemove(this);
 
 	QueueCEFTask([this]() { delete this; });
 }
@@ -147,34 +168,42 @@ void NotificationSource::ExecuteOnNotification(NotificationFunc func, bool async
 	if (!async) {
 #ifdef ENABLE_NOTIFICATION_QT_LOOP
 		if (QThread::currentThread() == qApp->thread()) {
-			if (!!cefNotification)
-				func(cefNotification);
+			CefRefPtr<CefBrowser> notification = GetNotification();
+			if (!!notification)
+				func(notification);
 			return;
 		}
 #endif
-		os_event_t *finishedEvent;
-		os_event_init(&finishedEvent, OS_EVENT_TYPE_AUTO);
-		bool success = QueueCEFTask([&]() {
-			if (!!cefNotification)
-				func(cefNotification);
-			os_event_signal(finishedEvent);
-		});
-		if (success) {
-			os_event_wait(finishedEvent);
-		}
-		os_event_destroy(finishedEvent);
+		QueueOnNotification(func).Wait();
 	} else {
 		CefRefPtr<CefBrowser> notification = GetNotification();
 		if (!!notification) {
-#ifdef ENABLE_NOTIFICATION_QT_LOOP
-			QueueNotificationTask(cefNotification, func);
-#else
-			QueueCEFTask([=]() { func(notification); });
-#endif
+			const uint64_t queued = os_gettime_ns();
+			QueueTask([this, notification, func = std::move(func), queued]() {
+				func(notification);
+				stats.task_latency.Add(os_gettime_ns() - queued);
+			});
 		}
 	}
 }
 
+NotificationFuture NotificationSource::QueueOnNotification(NotificationFunc func)
+{
+	NotificationPromise promise(&stats.task_latency, &stats.task_waits);
+	NotificationFuture future = promise.GetFuture();
+
+	const bool queued = QueueTask([this, func = std::move(func), promise]() mutable {
+		CefRefPtr<CefBrowser> notification = GetNotification();
+		if (!!notification)
+			func(notification);
+		promise.Resolve(!!notification);
+	});
+	if (!queued)
+		promise.Resolve(false);
+
+	return future;
+}
+
 bool NotificationSource::CreateNotification()
 {
 	return QueueCEFTask([this]() {
@@ -222,7 +251,14 @@ bool NotificationSource::CreateNotification()
 		cefNotificationSettings.windowless_frame_rate = (fps_custom) ? fps : canvas_fps;
 #endif
 #else
-		cefNotificationSettings.windowless_frame_rate = fps;
+		if (external_begin_frame) {
+			windowInfo.external_begin_frame_enabled = true;
+			cefNotificationSettings.windowless_frame_rate = 0;
+		} else {
+			cefNotificationSettings.windowless_frame_rate = fps;
+		}
+		begin_frame_driven = external_begin_frame;
+		begin_frame_interval = begin_frame_divider;
 #endif
 
 		cefNotificationSettings.default_font_size = 16;
@@ -239,13 +275,17 @@ bool NotificationSource::CreateNotification()
 								 CefRefPtr<CefDictionaryValue>(), nullptr);
 
 		SetNotification(notification);
+		if (viewport_mode != ViewportMode::Full)
+			ApplyViewport(notification);
+		current_fps = begin_frame_driven ? FullFrameRate() : cefNotificationSettings.windowless_frame_rate;
 
 		if (reroute_audio)
-			cefNotification->GetHost()->SetAudioMuted(true);
+			notification->GetHost()->SetAudioMuted(true);
 		if (obs_source_showing(source))
 			is_showing = true;
+		UpdateTier();
 
-		SendNotificationVisibility(cefNotification, is_showing);
+		SendNotificationVisibility(notification, is_showing && !culled);
 	});
 }
 
@@ -253,6 +293,9 @@ void NotificationSource::DestroyNotification()
 {
 	ExecuteOnNotification(ActuallyCloseNotification, true);
 	SetNotification(nullptr);
+	current_fps = 0;
+	begin_frame_driven = false;
+	frozen = false;
 }
 #if CHROME_VERSION_BUILD < 4103
 void NotificationSource::ClearAudioStreams()
@@ -267,71 +310,75 @@ void NotificationSource::ClearAudioStreams()
 void NotificationSource::SendMouseClick(const struct obs_mouse_event *event, int32_t type, bool mouse_up,
 				   uint32_t click_count)
 {
-	uint32_t modifiers = event->modifiers;
-	int32_t x = event->x;
-	int32_t y = event->y;
+	NotifyActivity();
 
-	ExecuteOnNotification(
-		[=](CefRefPtr<CefBrowser> cefNotification) {
-			CefMouseEvent e;
-			e.modifiers = modifiers;
-			e.x = x;
-			e.y = y;
-			CefBrowserHost::MouseButtonType buttonType = (CefBrowserHost::MouseButtonType)type;
-			cefNotification->GetHost()->SendMouseClickEvent(e, buttonType, mouse_up, click_count);
-		},
-		true);
+	uint32_t modifiers = event->modifiers;
+	const FrameRect view = GetViewport();
+	int32_t x = event->x - view.x;
+	int32_t y = event->y - view.y;
+
+	InputEvent input;
+	input.func = [=](CefRefPtr<CefBrowser> cefNotification) {
+		CefMouseEvent e;
+		e.modifiers = modifiers;
+		e.x = x;
+		e.y = y;
+		CefBrowserHost::MouseButtonType buttonType = (CefBrowserHost::MouseButtonType)type;
+		cefNotification->GetHost()->SendMouseClickEvent(e, buttonType, mouse_up, click_count);
+	};
+	QueueInput(std::move(input));
 }
 
 void NotificationSource::SendMouseMove(const struct obs_mouse_event *event, bool mouse_leave)
 {
-	uint32_t modifiers = event->modifiers;
-	int32_t x = event->x;
-	int32_t y = event->y;
+	NotifyActivity();
 
-	ExecuteOnNotification(
-		[=](CefRefPtr<CefBrowser> cefNotification) {
-			CefMouseEvent e;
-			e.modifiers = modifiers;
-			e.x = x;
-			e.y = y;
-			cefNotification->GetHost()->SendMouseMoveEvent(e, mouse_leave);
-		},
-		true);
+	const FrameRect view = GetViewport();
+
+	InputEvent input;
+	input.type = InputEvent::Type::Move;
+	input.modifiers = event->modifiers;
+	input.x = event->x - view.x;
+	input.y = event->y - view.y;
+	input.leave = mouse_leave;
+	QueueInput(std::move(input));
 }
 
 void NotificationSource::SendMouseWheel(const struct obs_mouse_event *event, int x_delta, int y_delta)
 {
-	uint32_t modifiers = event->modifiers;
-	int32_t x = event->x;
-	int32_t y = event->y;
-
-	ExecuteOnNotification(
-		[=](CefRefPtr<CefBrowser> cefNotification) {
-			CefMouseEvent e;
-			e.modifiers = modifiers;
-			e.x = x;
-			e.y = y;
-			cefNotification->GetHost()->SendMouseWheelEvent(e, x_delta, y_delta);
-		},
-		true);
+	NotifyActivity();
+
+	const FrameRect view = GetViewport();
+
+	InputEvent input;
+	input.type = InputEvent::Type::Wheel;
+	input.modifiers = event->modifiers;
+	input.x = event->x - view.x;
+	input.y = event->y - view.y;
+	input.x_delta = x_delta;
+	input.y_delta = y_delta;
+	QueueInput(std::move(input));
 }
 
 void NotificationSource::SendFocus(bool focus)
 {
-	ExecuteOnNotification(
-		[=](CefRefPtr<CefBrowser> cefNotification) {
+	NotifyActivity();
+
+	InputEvent input;
+	input.func = [=](CefRefPtr<CefBrowser> cefNotification) {
 #if CHROME_VERSION_BUILD < 4430
-			cefNotification->GetHost()->SendFocusEvent(focus);
+		cefNotification->GetHost()->SendFocusEvent(focus);
 #else
-			cefNotification->GetHost()->SetFocus(focus);
+		cefNotification->GetHost()->SetFocus(focus);
 #endif
-		},
-		true);
+	};
+	QueueInput(std::move(input));
 }
 
 void NotificationSource::SendKeyClick(const struct obs_key_event *event, bool key_up)
 {
+	NotifyActivity();
+
 	if (destroying)
 		return;
 
@@ -348,39 +395,127 @@ void NotificationSource::SendKeyClick(const struct obs_key_event *event, bool ke
 	uint32_t modifiers = event->native_modifiers;
 #endif
 
-	ExecuteOnNotification(
-		[=](CefRefPtr<CefBrowser> cefNotification) {
-			CefKeyEvent e;
-			e.windows_key_code = native_vkey;
+	InputEvent input;
+	input.func = [=](CefRefPtr<CefBrowser> cefNotification) {
+		CefKeyEvent e;
+		e.windows_key_code = native_vkey;
 #ifdef __APPLE__
-			e.native_key_code = native_vkey;
+		e.native_key_code = native_vkey;
 #endif
 
-			e.type = key_up ? KEYEVENT_KEYUP : KEYEVENT_RAWKEYDOWN;
+		e.type = key_up ? KEYEVENT_KEYUP : KEYEVENT_RAWKEYDOWN;
 
-			if (!text.empty()) {
-				wstring wide = to_wide(text);
-				if (wide.size())
-					e.character = wide[0];
-			}
+		if (!text.empty()) {
+			wstring wide = to_wide(text);
+			if (wide.size())
+				e.character = wide[0];
+		}
 
-			//e.native_key_code = native_vkey;
-			e.modifiers = modifiers;
+		//e.native_key_code = native_vkey;
+		e.modifiers = modifiers;
 
-			cefNotification->GetHost()->SendKeyEvent(e);
-			if (!text.empty() && !key_up) {
-				e.type = KEYEVENT_CHAR;
+		cefNotification->GetHost()->SendKeyEvent(e);
+		if (!text.empty() && !key_up) {
+			e.type = KEYEVENT_CHAR;
 #ifdef __linux__
-				e.windows_key_code = KeyboardCodeFromXKeysym(e.character);
+			e.windows_key_code = KeyboardCodeFromXKeysym(e.character);
 #elif defined(_WIN32)
-				e.windows_key_code = e.character;
+			e.windows_key_code = e.character;
 #elif !defined(__APPLE__)
-				e.native_key_code = native_scancode;
+			e.native_key_code = native_scancode;
 #endif
-				cefNotification->GetHost()->SendKeyEvent(e);
-			}
-		},
-		true);
+			cefNotification->GetHost()->SendKeyEvent(e);
+		}
+	};
+	QueueInput(std::move(input));
+}
+
+/* Moves and wheel events are merged with the event queued before them,
+ * clicks, keys and focus changes are barriers nothing is merged across.
+ * Whatever is queued until the flush task runs is delivered at once. */
+void NotificationSource::QueueInput(InputEvent &&event)
+{
+	if (destroying)
+		return;
+
+	event.queued = os_gettime_ns();
+	stats.input_events++;
+
+	lock_guard<mutex> lock(input_mutex);
+	if (event.type != InputEvent::Type::Other && !input_events.empty()) {
+		InputEvent &last = input_events.back();
+		if (last.type == event.type && last.modifiers == event.modifiers && !last.leave) {
+			last.x = event.x;
+			last.y = event.y;
+			last.leave = event.leave;
+			last.x_delta += event.x_delta;
+			last.y_delta += event.y_delta;
+			return;
+		}
+	}
+
+	input_events.push_back(std::move(event));
+	if (input_flush_queued)
+		return;
+
+	input_flush_queued = QueueTask([this]() { FlushInput(); });
+	if (!input_flush_queued)
+		input_events.clear();
+}
+
+void NotificationSource::FlushInput()
+{
+	{
+		lock_guard<mutex> lock(input_mutex);
+		input_batch.swap(input_events);
+		input_flush_queued = false;
+	}
+
+	CefRefPtr<CefBrowser> notification = GetNotification();
+	if (!notification || input_batch.empty()) {
+		input_batch.clear();
+		return;
+	}
+
+	CefRefPtr<CefBrowserHost> host = notification->GetHost();
+	const uint64_t now = os_gettime_ns();
+
+	for (InputEvent &event : input_batch) {
+		stats.input_delay.Add(now - event.queued);
+
+		CefMouseEvent e;
+		e.modifiers = event.modifiers;
+		e.x = event.x;
+		e.y = event.y;
+
+		switch (event.type) {
+		case InputEvent::Type::Move:
+			host->SendMouseMoveEvent(e, event.leave);
+			break;
+		case InputEvent::Type::Wheel:
+			host->SendMouseWheelEvent(e, event.x_delta, event.y_delta);
+			break;
+		case InputEvent::Type::Other:
+			event.func(notification);
+			break;
+		}
+	}
+
+	uint64_t unpainted = 0;
+	input_unpainted.compare_exchange_strong(unpainted, input_batch.front().queued);
+
+	stats.input_delivered += input_batch.size();
+	stats.input_flushes++;
+	input_batch.clear();
+}
+
+/* Called for every paint of the view, paints that were not caused by input
+ * end up in the histogram as well when input was delivered before them */
+void NotificationSource::InputPainted()
+{
+	const uint64_t queued = input_unpainted.exchange(0);
+	if (queued)
+		stats.input_to_paint.Add(os_gettime_ns() - queued);
 }
 
 void NotificationSource::SetShowing(bool showing)
@@ -389,6 +524,7 @@ void NotificationSource::SetShowing(bool showing)
 		return;
 
 	is_showing = showing;
+	UpdateTier();
 
 	if (shutdown_on_invisible) {
 		if (showing) {
@@ -397,40 +533,57 @@ void NotificationSource::SetShowing(bool showing)
 			DestroyNotification();
 		}
 	} else {
-		ExecuteOnNotification(
-			[=](CefRefPtr<CefBrowser> cefNotification) {
-				CefRefPtr<CefProcessMessage> msg = CefProcessMessage::Create("Visibility");
-				CefRefPtr<CefListValue> args = msg->GetArgumentList();
-				args->SetBool(0, showing);
-				SendNotificationProcessMessage(cefNotification, PID_RENDERER, msg);
-			},
-			true);
-		nlohmann::json json;
-		json["visible"] = showing;
-		DispatchJSEvent("obsSourceVisibleChanged", json.dump(), this);
-#if defined(NOTIFICATION_EXTERNAL_BEGIN_FRAME_ENABLED) && defined(ENABLE_BROWSER_SHARED_TEXTURE)
-		if (showing && !fps_custom) {
-			reset_frame = false;
-		}
-#endif
-
-		SendNotificationVisibility(cefNotification, showing);
+		SetPageVisible(showing && !culled);
+	}
+}
 
-		if (showing)
-			return;
+void NotificationSource::SetCulled(bool cull)
+{
+	if (cull == culled)
+		return;
 
-		obs_enter_graphics();
+	culled = cull;
+	UpdateTier();
 
-		if (!hwaccel && texture) {
-			DestroyTextures();
-		}
+	/* Culled pages are only hidden, never shut down, so they come back
+	 * without a reload */
+	if (is_showing)
+		SetPageVisible(!cull);
+}
 
-		obs_leave_graphics();
+void NotificationSource::SetPageVisible(bool visible)
+{
+	ExecuteOnNotification(
+		[=](CefRefPtr<CefBrowser> cefNotification) {
+			CefRefPtr<CefProcessMessage> msg = CefProcessMessage::Create("Visibility");
+			CefRefPtr<CefListValue> args = msg->GetArgumentList();
+			args->SetBool(0, visible);
+			SendNotificationProcessMessage(cefNotification, PID_RENDERER, msg);
+		},
+		true);
+	nlohmann::json json;
+	json["visible"] = visible;
+	DispatchJSEvent("obsSourceVisibleChanged", json.dump(), this, false);
+#if defined(NOTIFICATION_EXTERNAL_BEGIN_FRAME_ENABLED) && defined(ENABLE_BROWSER_SHARED_TEXTURE)
+	if (visible && !fps_custom) {
+		reset_frame = false;
 	}
+#endif
+
+	SendNotificationVisibility(GetNotification(), visible);
+
+	if (visible)
+		return;
+
+	if (!hwaccel)
+		DestroyTextures();
 }
 
 void NotificationSource::SetActive(bool active)
 {
+	is_active = active;
+	UpdateTier();
+
 	ExecuteOnNotification(
 		[=](CefRefPtr<CefBrowser> cefNotification) {
 			CefRefPtr<CefProcessMessage> msg = CefProcessMessage::Create("Active");
@@ -441,24 +594,288 @@ void NotificationSource::SetActive(bool active)
 		true);
 	nlohmann::json json;
 	json["active"] = active;
-	DispatchJSEvent("obsSourceActiveChanged", json.dump(), this);
+	DispatchJSEvent("obsSourceActiveChanged", json.dump(), this, false);
 }
 
 void NotificationSource::Refresh()
 {
+	NotifyActivity();
 	ExecuteOnNotification([](CefRefPtr<CefBrowser> cefNotification) { cefNotification->ReloadIgnoreCache(); }, true);
 }
 
+static void SetPageLifecycleState(CefRefPtr<CefBrowser> cefNotification, const char *state)
+{
+#if ENABLE_WASHIDDEN
+	CefRefPtr<CefDictionaryValue> params = CefDictionaryValue::Create();
+	params->SetString("state", state);
+	cefNotification->GetHost()->ExecuteDevToolsMethod(0, "Page.setWebLifecycleState", params);
+#else
+	UNUSED_PARAMETER(cefNotification);
+	UNUSED_PARAMETER(state);
+#endif
+}
+
+/* The page is hidden first, Chromium only freezes hidden pages. The view
+ * texture is left alone so Render keeps drawing the last frame. */
+void NotificationSource::Freeze()
+{
+	if (frozen.exchange(true))
+		return;
+
+	stats.freezes++;
+	ExecuteOnNotification(
+		[](CefRefPtr<CefBrowser> cefNotification) {
+#if ENABLE_WASHIDDEN
+			cefNotification->GetHost()->WasHidden(true);
+#endif
+			SetPageLifecycleState(cefNotification, "frozen");
+		},
+		true);
+}
+
+/* Queued ahead of whatever woke the page up, so it is handled by the running
+ * page within the frame */
+void NotificationSource::Thaw()
+{
+	if (!frozen.exchange(false))
+		return;
+
+	ExecuteOnNotification(
+		[this](CefRefPtr<CefBrowser> cefNotification) {
+			SetPageLifecycleState(cefNotification, "active");
+#if ENABLE_WASHIDDEN
+			if (is_showing && !culled) {
+				cefNotification->GetHost()->WasHidden(false);
+				cefNotification->GetHost()->Invalidate(PET_VIEW);
+			}
+#endif
+		},
+		true);
+}
+
+/* Per source, a clip that would go past either is discarded */
+static constexpr size_t MAX_BAKED_CLIPS = 16;
+static constexpr size_t MAX_BAKED_BYTES = 256 * 1024 * 1024;
+
+void NotificationSource::StartBake(const std::string &key)
+{
+	bake_recording = std::make_shared<BakedClip>();
+	bake_recording_key = key;
+
+	/* The frame on screen right now is the first one of the clip, even
+	 * if the next paint does not change it */
+	tile_hasher.Reset();
+}
+
+void NotificationSource::RecordBakeFrame(const uint8_t *buffer, int width, int height, const FrameRect &bounds)
+{
+	if (bake_recording->AddFrame(buffer, width, height, bounds, os_gettime_ns()))
+		return;
+
+	blog(LOG_WARNING, "[spt-notification: '%s'] Baked animation '%s' is too long or was resized, discarding it",
+	     obs_source_get_name(source), bake_recording_key.c_str());
+	bake_recording.reset();
+}
+
+void NotificationSource::StopBake()
+{
+	std::shared_ptr<BakedClip> clip = std::move(bake_recording);
+	if (!clip || clip->Empty())
+		return;
+
+	clip->Finish(os_gettime_ns());
+
+	std::shared_ptr<BakedClip> replaced;
+	size_t count = 0;
+	size_t total = clip->Bytes();
+	{
+		std::lock_guard<std::mutex> lock(bake_mutex);
+		for (const auto &[key, other] : baked_clips) {
+			if (key != bake_recording_key)
+				total += other->Bytes();
+		}
+		count = baked_clips.size() + (baked_clips.count(bake_recording_key) ? 0 : 1);
+
+		if (count <= MAX_BAKED_CLIPS && total <= MAX_BAKED_BYTES) {
+			std::shared_ptr<BakedClip> &slot = baked_clips[bake_recording_key];
+			replaced = std::move(slot);
+			slot = clip;
+		}
+	}
+
+	if (count > MAX_BAKED_CLIPS || total > MAX_BAKED_BYTES) {
+		blog(LOG_WARNING,
+		     "[spt-notification: '%s'] Baked animation '%s' would make %zu clips of %.1f MB, discarding it",
+		     obs_source_get_name(source), bake_recording_key.c_str(), count, (double)total / (1024.0 * 1024.0));
+		return;
+	}
+
+	blog(LOG_INFO, "[spt-notification: '%s'] Baked animation '%s': %zu frames, %zu distinct, %.1f MB",
+	     obs_source_get_name(source), bake_recording_key.c_str(), clip->Frames(), clip->Images(),
+	     (double)clip->Bytes() / (1024.0 * 1024.0));
+}
+
+bool NotificationSource::PlayBaked(const std::string &key)
+{
+	std::shared_ptr<BakedClip> replaced;
+
+	std::lock_guard<std::mutex> lock(bake_mutex);
+	auto it = baked_clips.find(key);
+	if (it == baked_clips.end())
+		return false;
+
+	replaced = std::exchange(bake_playing, it->second);
+	bake_playing_key = key;
+	bake_play_start = 0;
+	return true;
+}
+
+/* The clip starts with the first render after it was asked for. The page is
+ * told once it is over, so it can clean up its dynamic parts. */
+std::shared_ptr<BakedClip> NotificationSource::GetPlayingClip(uint64_t frame_time, int &frame)
+{
+	std::shared_ptr<BakedClip> clip;
+	std::shared_ptr<BakedClip> ended;
+	std::string key;
+	{
+		std::lock_guard<std::mutex> lock(bake_mutex);
+		if (bake_playing) {
+			if (!bake_play_start)
+				bake_play_start = frame_time;
+
+			frame = bake_playing->FrameAt(frame_time - bake_play_start);
+			if (frame >= 0) {
+				clip = bake_playing;
+			} else {
+				ended = std::move(bake_playing);
+				key = std::move(bake_playing_key);
+			}
+		}
+	}
+
+	/* Frames of clips that are not on screen are uploaded again when
+	 * they are played next time */
+	if (bake_uploaded != clip) {
+		if (bake_uploaded)
+			bake_uploaded->ReleaseTextures();
+		bake_uploaded = clip;
+	}
+
+	if (ended) {
+		nlohmann::json json;
+		json["key"] = key;
+		DispatchJSEvent("obsBakedAnimationEnded", json.dump(), this, false);
+	}
+
+	return clip;
+}
+
+static nlohmann::json GetHistogramJson(const LatencyHistogram &histogram)
+{
+	nlohmann::json json = nlohmann::json::object();
+	for (size_t i = 0; i < LatencyHistogram::BUCKETS; i++) {
+		const uint64_t count = histogram.counts[i];
+		if (!count)
+			continue;
+
+		if (i == LatencyHistogram::BUCKETS - 1)
+			json[">=" + std::to_string(1ULL << (i - 1)) + "us"] = count;
+		else
+			json["<" + std::to_string(1ULL << i) + "us"] = count;
+	}
+	return json;
+}
+
+static const char *GetFrameRateTierName(FrameRateTier tier)
+{
+	switch (tier) {
+	case FrameRateTier::Program:
+		return "program";
+	case FrameRateTier::Preview:
+		return "preview";
+	case FrameRateTier::Hidden:
+		return "hidden";
+	}
+
+	return "unknown";
+}
+
+std::string NotificationSource::GetStatsJson()
+{
+	nlohmann::json json = {{"frames_painted", stats.frames_painted.load()},
+			       {"frames_unchanged", stats.frames_unchanged.load()},
+			       {"bytes_painted", stats.bytes_painted.load()},
+			       {"bytes_skipped", stats.bytes_skipped.load()},
+			       {"render_calls", stats.render_calls.load()},
+			       {"render_frames", stats.render_frames.load()},
+			       {"extra_copies", stats.extra_copies.load()},
+			       {"extra_copies_skipped", stats.extra_copies_skipped.load()},
+			       {"extra_copy_bytes_saved", stats.extra_copy_bytes_saved.load()},
+			       {"fps", current_fps.load()},
+			       {"tier", GetFrameRateTierName(tier)},
+			       {"culled", culled.load()},
+			       {"view_scale", view_scale.load()},
+			       {"governor_step", governor_step},
+			       {"frozen", frozen.load()},
+			       {"freezes", stats.freezes.load()},
+			       {"begin_frame_interval", begin_frame_driven ? begin_frame_interval.load() : 0},
+			       {"empty", IsEmpty()},
+			       {"opaque", GetFrameAlpha() == FrameAlpha::Opaque}};
+
+	nlohmann::json rate_time = nlohmann::json::object();
+	{
+		lock_guard<mutex> lock(stats.rate_mutex);
+		for (const auto &[rate, ns] : stats.rate_time)
+			rate_time[std::to_string(rate)] = (double)ns / 1000000000.0;
+	}
+	json["fps_seconds"] = rate_time;
+	json["task_latency"] = GetHistogramJson(stats.task_latency);
+	json["task_waits"] = GetHistogramJson(stats.task_waits);
+	json["input_events"] = stats.input_events.load();
+	json["input_delivered"] = stats.input_delivered.load();
+	json["input_flushes"] = stats.input_flushes.load();
+	json["input_delay"] = GetHistogramJson(stats.input_delay);
+	json["input_to_paint"] = GetHistogramJson(stats.input_to_paint);
+
+	/* The queue is shared by all sources */
+	const TaskQueueStats &queue_stats = GetTaskQueueStats();
+	nlohmann::json batch_sizes = nlohmann::json::object();
+	for (size_t i = 0; i < TaskQueueStats::BATCH_BUCKETS; i++) {
+		const uint64_t count = queue_stats.batch_sizes[i];
+		if (!count)
+			continue;
+
+		if (i == TaskQueueStats::BATCH_BUCKETS - 1)
+			batch_sizes[">=" + std::to_string(1ULL << i)] = count;
+		else
+			batch_sizes[std::to_string(1ULL << i) + "-" + std::to_string((2ULL << i) - 1)] = count;
+	}
+	json["task_queue"] = {{"tasks", queue_stats.tasks.load()},
+			      {"drains", queue_stats.drains.load()},
+			      {"max_batch", queue_stats.max_batch.load()},
+			      {"batch_sizes", batch_sizes},
+			      {"delay", GetHistogramJson(queue_stats.delay)}};
+
+	{
+		lock_guard<mutex> lock(bake_mutex);
+		size_t baked_bytes = 0;
+		for (const auto &[key, clip] : baked_clips)
+			baked_bytes += clip->Bytes();
+		json["baked_clips"] = baked_clips.size();
+		json["baked_bytes"] = baked_bytes;
+	}
+
+	return json.dump();
+}
+
 void NotificationSource::SetNotification(CefRefPtr<CefBrowser> b)
 {
-	std::lock_guard<std::recursive_mutex> auto_lock(lockNotification);
-	cefNotification = b;
+	cefNotification.Store(b);
 }
 
 CefRefPtr<CefBrowser> NotificationSource::GetNotification()
 {
-	std::lock_guard<std::recursive_mutex> auto_lock(lockNotification);
-	return cefNotification;
+	return cefNotification.Load();
 }
 
 #ifdef ENABLE_BROWSER_SHARED_TEXTURE
@@ -476,14 +893,72 @@ inline void NotificationSource::SignalBeginFrame()
 #endif
 #endif
 
+/* Largest width and height the properties allow */
+static constexpr int MAX_PAGE_SIZE = 8192;
+
 void NotificationSource::Update(obs_data_t *settings)
 {
+	NotifyActivity();
+
 	if (settings) {
+		const std::string n_tag = obs_data_get_string(settings, "tag");
+		if (n_tag != tag) {
+			tag = n_tag;
+			NotificationRegistrySetKeys(this, url, tag);
+		}
+
+		/* Upload settings only affect how frames reach the texture and
+		 * can be applied without recreating the browser */
+		partial_upload_threshold = (int)obs_data_get_int(settings, "partial_upload_threshold");
+		change_detection = obs_data_get_bool(settings, "change_detection");
+		trim_transparent = obs_data_get_bool(settings, "trim_transparent");
+		adaptive_fps = obs_data_get_bool(settings, "adaptive_fps");
+		adaptive_idle_frames = (int)obs_data_get_int(settings, "adaptive_idle_frames");
+		adaptive_min_fps = (int)obs_data_get_int(settings, "adaptive_min_fps");
+		adaptive_max_fps = (int)obs_data_get_int(settings, "adaptive_max_fps");
+#if ENABLE_WASHIDDEN
+		idle_freeze = obs_data_get_bool(settings, "idle_freeze");
+		idle_freeze_seconds = (int)obs_data_get_int(settings, "idle_freeze_seconds");
+#endif
+		begin_frame_divider = std::max((int)obs_data_get_int(settings, "begin_frame_divider"), 1);
+		frame_rate_tiers = obs_data_get_bool(settings, "frame_rate_tiers");
+		preview_fps = (int)obs_data_get_int(settings, "preview_fps");
+		hidden_fps = (int)obs_data_get_int(settings, "hidden_fps");
+		visibility_culling = obs_data_get_bool(settings, "visibility_culling");
+		if (!visibility_culling)
+			SetCulled(false);
+		auto_resolution = obs_data_get_bool(settings, "auto_resolution");
+		if (!auto_resolution) {
+			auto_scale = 1.0f;
+			auto_scale_frames = 0;
+		}
+		lag_governor = obs_data_get_bool(settings, "lag_governor");
+		if (!lag_governor)
+			SetGovernorStep(0);
+		render_scale = std::clamp((float)obs_data_get_double(settings, "render_scale"), 0.25f, 1.0f);
+		scale_filter = static_cast<obs_scale_type>(obs_data_get_int(settings, "render_scale_filter"));
+		UpdateViewScale();
+#if CHROME_VERSION_BUILD > 4183
+		viewport_mode = static_cast<ViewportMode>(obs_data_get_int(settings, "viewport_mode"));
+#endif
+		if (viewport_mode == ViewportMode::Manual) {
+			/* A width or height of 0 reaches to the edge of the page */
+			const int n_view_x = (int)obs_data_get_int(settings, "viewport_x");
+			const int n_view_y = (int)obs_data_get_int(settings, "viewport_y");
+			const int n_view_cx = (int)obs_data_get_int(settings, "viewport_width");
+			const int n_view_cy = (int)obs_data_get_int(settings, "viewport_height");
+			SetViewport(FrameRect(n_view_x, n_view_y, n_view_cx > 0 ? n_view_cx : MAX_PAGE_SIZE,
+					      n_view_cy > 0 ? n_view_cy : MAX_PAGE_SIZE));
+		} else if (viewport_mode == ViewportMode::Full) {
+			SetViewport(FrameRect());
+		}
+
 		bool n_is_local;
 		int n_width;
 		int n_height;
 		bool n_fps_custom;
 		int n_fps;
+		bool n_external_begin_frame;
 		bool n_shutdown;
 		bool n_restart;
 		bool n_reroute;
@@ -496,6 +971,11 @@ void NotificationSource::Update(obs_data_t *settings)
 		n_height = (int)obs_data_get_int(settings, "height");
 		n_fps_custom = obs_data_get_bool(settings, "fps_custom");
 		n_fps = (int)obs_data_get_int(settings, "fps");
+#ifndef ENABLE_BROWSER_SHARED_TEXTURE
+		n_external_begin_frame = obs_data_get_bool(settings, "external_begin_frame");
+#else
+		n_external_begin_frame = false;
+#endif
 		n_shutdown = obs_data_get_bool(settings, "shutdown");
 		n_restart = obs_data_get_bool(settings, "restart_when_active");
 		n_css = obs_data_get_string(settings, "css");
@@ -545,7 +1025,8 @@ void NotificationSource::Update(obs_data_t *settings)
 #endif
 
 		if (n_is_local == is_local && n_fps_custom == fps_custom && n_fps == fps &&
-		    n_shutdown == shutdown_on_invisible && n_restart == restart && n_css == css && n_url == url &&
+		    n_external_begin_frame == external_begin_frame && n_shutdown == shutdown_on_invisible &&
+		    n_restart == restart && n_css == css && n_url == url &&
 		    n_reroute == reroute_audio && n_webpage_control_level == webpage_control_level) {
 
 			if (n_width == width && n_height == height)
@@ -558,6 +1039,8 @@ void NotificationSource::Update(obs_data_t *settings)
 					const CefSize cefSize(width, height);
 					cefNotification->GetHost()->GetClient()->GetDisplayHandler()->OnAutoResize(
 						cefNotification, cefSize);
+					if (viewport_mode != ViewportMode::Full)
+						ApplyViewport(cefNotification);
 					cefNotification->GetHost()->WasResized();
 					cefNotification->GetHost()->Invalidate(PET_VIEW);
 				},
@@ -570,12 +1053,14 @@ void NotificationSource::Update(obs_data_t *settings)
 		height = n_height;
 		fps = n_fps;
 		fps_custom = n_fps_custom;
+		external_begin_frame = n_external_begin_frame;
 		shutdown_on_invisible = n_shutdown;
 		reroute_audio = n_reroute;
 		webpage_control_level = n_webpage_control_level;
 		restart = n_restart;
 		css = n_css;
 		url = n_url;
+		NotificationRegistrySetKeys(this, url, tag);
 
 		obs_source_set_audio_active(source, reroute_audio);
 	}
@@ -591,6 +1076,50 @@ void NotificationSource::Update(obs_data_t *settings)
 	first_update = false;
 }
 
+/* Checks all culling, auto-resolution and scene crop sources at once, from
+ * the first tick of a video frame that needs it */
+static void RunSceneChecks()
+{
+	static uint64_t last_frame_time = 0;
+	const uint64_t frame_time = obs_get_video_frame_time();
+	if (frame_time == last_frame_time)
+		return;
+	last_frame_time = frame_time;
+
+	CefRefPtr<RegistrySnapshot> registry = GetNotificationRegistry();
+	if (!registry)
+		return;
+
+	vector<CullResult> results;
+	for (const RegistryEntry &entry : registry->entries) {
+		obs_source_t *ref = obs_weak_source_get_source(entry.weak);
+		if (!ref)
+			continue;
+
+		NotificationSource *bs = entry.bs;
+		const bool check = bs->visibility_culling || bs->auto_resolution ||
+				   bs->viewport_mode == ViewportMode::SceneCrop;
+		if (check)
+			results.push_back({bs});
+		else
+			obs_source_release(ref);
+	}
+
+	CheckNotificationVisibility(results);
+
+	for (CullResult &result : results) {
+		/* Sources shown outside of any scene are never culled */
+		if (result.bs->visibility_culling)
+			result.bs->SetCulled(result.seen && !result.visible);
+		/* Sources that can not be seen keep their last resolution */
+		if (result.bs->auto_resolution && result.visible)
+			result.bs->SetAutoScale(result.scale);
+		if (result.bs->viewport_mode == ViewportMode::SceneCrop && result.visible)
+			result.bs->SetViewport(result.region);
+		obs_source_release(result.bs->source);
+	}
+}
+
 void NotificationSource::Tick()
 {
 	if (create_notification && CreateNotification())
@@ -605,13 +1134,407 @@ void NotificationSource::Tick()
 	double video_fps = (double)ovi.fps_num / (double)ovi.fps_den;
 
 	if (!fps_custom) {
-		if (!!cefNotification && canvas_fps != video_fps) {
-			cefNotification->GetHost()->SetWindowlessFrameRate(video_fps);
+		CefRefPtr<CefBrowser> notification = GetNotification();
+		if (!!notification && canvas_fps != video_fps) {
+			notification->GetHost()->SetWindowlessFrameRate(video_fps);
 			canvas_fps = video_fps;
 		}
 	}
 #endif
 #endif
+
+	if (visibility_culling || auto_resolution || viewport_mode == ViewportMode::SceneCrop)
+		RunSceneChecks();
+
+	if (lag_governor) {
+		/* Every tier backs off one level later than the one below it */
+		const int offset = tier == FrameRateTier::Hidden ? 0 : tier == FrameRateTier::Preview ? 1 : 2;
+		SetGovernorStep(std::clamp(GovernorUpdate() - offset, 0, GOVERNOR_MAX_STEP));
+	}
+
+	UpdateFrameRate();
+
+	if (idle_freeze && !frozen && os_gettime_ns() - active_time >= (uint64_t)idle_freeze_seconds * 1000000000ULL)
+		Freeze();
+
+	if (begin_frame_driven && is_showing && !frozen && ++begin_frame_count >= begin_frame_interval) {
+		begin_frame_count = 0;
+		ExecuteOnNotification(
+			[](CefRefPtr<CefBrowser> cefNotification) { cefNotification->GetHost()->SendExternalBeginFrame(); },
+			true);
+	}
+}
+
+static double GetVideoFrameRate()
+{
+	struct obs_video_info ovi;
+	obs_get_video_info(&ovi);
+	return (double)ovi.fps_num / (double)ovi.fps_den;
+}
+
+int NotificationSource::FullFrameRate() const
+{
+#if defined(ENABLE_BROWSER_SHARED_TEXTURE) && defined(NOTIFICATION_EXTERNAL_BEGIN_FRAME_ENABLED)
+	/* OBS requests every frame, there is no timer to slow down */
+	if (!fps_custom)
+		return 0;
+#elif defined(ENABLE_BROWSER_SHARED_TEXTURE)
+	if (!fps_custom)
+		return (int)GetVideoFrameRate();
+#endif
+	if (begin_frame_driven)
+		return std::max((int)(GetVideoFrameRate() / begin_frame_divider), 1);
+	return fps;
+}
+
+void NotificationSource::UpdateFrameRate()
+{
+	const int applied = current_fps;
+	const uint64_t now = os_gettime_ns();
+	if (applied && rate_time)
+		stats.AddRateTime(applied, now - rate_time);
+	rate_time = now;
+
+	/* Paints bump the content generation, JS events and input set the
+	 * activity flag. Either one brings the browser back to full rate
+	 * right away, slowing down again takes a run of quiet frames. */
+	const uint64_t generation = content_generation;
+	if (activity.exchange(false) || generation != seen_generation || !cefNotification) {
+		seen_generation = generation;
+		quiet_frames = 0;
+		active_time = now;
+	} else if (quiet_frames < adaptive_idle_frames) {
+		quiet_frames++;
+	}
+
+	const int full_fps = FullFrameRate();
+	if (!applied || !full_fps)
+		return;
+
+	int target = full_fps;
+	if (frame_rate_tiers) {
+		const FrameRateTier current_tier = tier;
+		if (current_tier == FrameRateTier::Preview)
+			target = std::min(target, preview_fps);
+		else if (current_tier == FrameRateTier::Hidden)
+			target = std::min(target, hidden_fps);
+	}
+	if (governor_step)
+		target = std::min(target, std::max(full_fps / GovernorFrameRateDivider(governor_step), 1));
+	if (adaptive_fps) {
+		if (adaptive_max_fps > 0)
+			target = std::min(target, adaptive_max_fps);
+		if (quiet_frames >= adaptive_idle_frames)
+			target = std::min(target, adaptive_min_fps);
+	}
+
+	if (target == applied)
+		return;
+
+	current_fps = target;
+
+	/* Begin frame driven browsers are slowed down by skipping frames. The
+	 * interval is scaled from the divider, since full_fps is rounded and
+	 * dividing the video rate by it would not give the divider back. */
+	if (begin_frame_driven) {
+		int interval = begin_frame_divider;
+		if (target < full_fps)
+			interval = std::max((int)std::lround(begin_frame_divider * (double)full_fps / target), interval);
+		begin_frame_interval = interval;
+		return;
+	}
+
+	ExecuteOnNotification(
+		[target](CefRefPtr<CefBrowser> cefNotification) {
+			cefNotification->GetHost()->SetWindowlessFrameRate(target);
+		},
+		true);
+}
+
+/* Auto-resolution scales are rounded up to steps of 1/AUTO_SCALE_STEPS, and
+ * only go down after a second at the lower scale, so that animated items do
+ * not resize the page every frame */
+static constexpr float AUTO_SCALE_STEPS = 8.0f;
+
+void NotificationSource::SetAutoScale(float scale)
+{
+	scale = std::clamp(std::ceil(scale * AUTO_SCALE_STEPS) / AUTO_SCALE_STEPS, 1.0f / AUTO_SCALE_STEPS, 1.0f);
+
+	if (scale >= auto_scale) {
+		auto_scale_frames = 0;
+		if (scale == auto_scale)
+			return;
+	} else if (++auto_scale_frames < (int)GetVideoFrameRate()) {
+		return;
+	}
+
+	auto_scale = scale;
+	auto_scale_frames = 0;
+	UpdateViewScale();
+}
+
+void NotificationSource::SetGovernorStep(int step)
+{
+	if (step == governor_step)
+		return;
+
+	blog(LOG_INFO, "[spt-notification: '%s'] Lag governor step %d -> %d (%s)", obs_source_get_name(source),
+	     governor_step, step, GetFrameRateTierName(tier));
+
+	governor_step = step;
+	UpdateViewScale();
+}
+
+void NotificationSource::UpdateViewScale()
+{
+	const float scale = auto_scale * render_scale * GovernorRenderScale(governor_step);
+	if (scale == view_scale)
+		return;
+
+	view_scale = scale;
+	ExecuteOnNotification(
+		[](CefRefPtr<CefBrowser> cefNotification) {
+			cefNotification->GetHost()->NotifyScreenInfoChanged();
+			cefNotification->GetHost()->WasResized();
+			cefNotification->GetHost()->Invalidate(PET_VIEW);
+		},
+		true);
+}
+
+FrameRect NotificationSource::GetViewport()
+{
+	const FrameRect page(0, 0, std::max(width, 1), std::max(height, 1));
+
+	std::lock_guard<std::mutex> lock(viewport_mutex);
+	const FrameRect view = viewport.Intersect(page);
+	return view.Empty() ? page : view;
+}
+
+void NotificationSource::SetViewport(const FrameRect &rect)
+{
+	{
+		std::lock_guard<std::mutex> lock(viewport_mutex);
+		if (rect.x == viewport.x && rect.y == viewport.y && rect.cx == viewport.cx && rect.cy == viewport.cy)
+			return;
+		viewport = rect;
+	}
+
+	ExecuteOnNotification(
+		[this](CefRefPtr<CefBrowser> cefNotification) {
+			ApplyViewport(cefNotification);
+			cefNotification->GetHost()->WasResized();
+			cefNotification->GetHost()->Invalidate(PET_VIEW);
+		},
+		true);
+}
+
+/* Keeps the page laid out at width/height while only the viewport of it is
+ * shown in the view. The page does not notice, viewport units and fixed
+ * elements stay where they are. */
+void NotificationSource::ApplyViewport(CefRefPtr<CefBrowser> cefNotification)
+{
+#if CHROME_VERSION_BUILD > 4183
+	const FrameRect view = GetViewport();
+	CefRefPtr<CefBrowserHost> host = cefNotification->GetHost();
+
+	if (view.x == 0 && view.y == 0 && view.cx == std::max(width, 1) && view.cy == std::max(height, 1)) {
+		host->ExecuteDevToolsMethod(0, "Emulation.clearDeviceMetricsOverride", nullptr);
+		return;
+	}
+
+	CefRefPtr<CefDictionaryValue> area = CefDictionaryValue::Create();
+	area->SetDouble("x", view.x);
+	area->SetDouble("y", view.y);
+	area->SetDouble("width", view.cx);
+	area->SetDouble("height", view.cy);
+	area->SetDouble("scale", 1.0);
+
+	CefRefPtr<CefDictionaryValue> params = CefDictionaryValue::Create();
+	params->SetInt("width", width);
+	params->SetInt("height", height);
+	/* 0 keeps the scale factor from GetScreenInfo */
+	params->SetDouble("deviceScaleFactor", 0.0);
+	params->SetBool("mobile", false);
+	params->SetDictionary("viewport", area);
+	host->ExecuteDevToolsMethod(0, "Emulation.setDeviceMetricsOverride", params);
+#else
+	UNUSED_PARAMETER(cefNotification);
+#endif
+}
+
+/* Textures cover the visible content snapped to this grid, so that content
+ * which moves or grows a little does not need a new texture every frame */
+static constexpr int TEXTURE_ALIGN = 64;
+
+static FrameRect AlignedTextureRect(const FrameRect &bounds, int width, int height)
+{
+	const int l = bounds.x / TEXTURE_ALIGN * TEXTURE_ALIGN;
+	const int t = bounds.y / TEXTURE_ALIGN * TEXTURE_ALIGN;
+	const int r = (bounds.Right() + TEXTURE_ALIGN - 1) / TEXTURE_ALIGN * TEXTURE_ALIGN;
+	const int b = (bounds.Bottom() + TEXTURE_ALIGN - 1) / TEXTURE_ALIGN * TEXTURE_ALIGN;
+
+	return FrameRect(l, t, r - l, b - t).Clip(width, height);
+}
+
+bool NotificationSource::UploadDirtyRects(const FrameMailbox::Frame &frame)
+{
+	if (partial_upload_threshold <= 0 || frame.full_damage)
+		return false;
+
+	DirtyRegion damage;
+	for (size_t i = 0; i < frame.damage.Count(); i++)
+		damage.Add(frame.damage[i].Intersect(texture_rect));
+
+	if (damage.Area() * 100 > texture_rect.Area() * partial_upload_threshold)
+		return false;
+
+#ifdef ENABLE_NOTIFICATION_GL_UPLOAD
+	if (GLUploadAvailable()) {
+		if (!GLUploadBegin(texture, (size_t)damage.Area() * 4))
+			return false;
+
+		for (size_t i = 0; i < damage.Count(); i++) {
+			const FrameRect &rect = damage[i];
+			GLUploadCopy(frame.data.data(), frame.Linesize(), rect, rect.x - texture_rect.x,
+				     rect.y - texture_rect.y);
+		}
+
+		GLUploadEnd();
+		staging_valid = false;
+		return true;
+	}
+#endif
+
+	/* Partial updates through a map rely on the texture's staging memory
+	 * keeping its previous contents. That holds for the OpenGL pixel
+	 * unpack buffer, but D3D11 maps dynamic textures with WRITE_DISCARD,
+	 * so everything else always gets a full upload. */
+	if (gs_get_device_type() != GS_DEVICE_OPENGL || !staging_valid)
+		return false;
+
+	uint8_t *ptr;
+	uint32_t linesize;
+	if (!gs_texture_map(texture, &ptr, &linesize))
+		return false;
+
+	for (size_t i = 0; i < damage.Count(); i++) {
+		const FrameRect &rect = damage[i];
+		CopyFrameRect(ptr, linesize, frame.data.data(), frame.Linesize(), rect, rect.x - texture_rect.x,
+			      rect.y - texture_rect.y);
+	}
+
+	gs_texture_unmap(texture);
+	return true;
+}
+
+void NotificationSource::UploadTextureRect(const FrameMailbox::Frame &frame)
+{
+#ifdef ENABLE_NOTIFICATION_GL_UPLOAD
+	if (GLUploadAvailable()) {
+		/* Same border as ClearFrameBorder leaves around texture_rect */
+		const int tex_cx = (int)gs_texture_get_width(texture);
+		const int tex_cy = (int)gs_texture_get_height(texture);
+		const FrameRect right = FrameRect(texture_rect.cx, 0, 1, texture_rect.cy + 1).Clip(tex_cx, tex_cy);
+		const FrameRect below = FrameRect(0, texture_rect.cy, texture_rect.cx, 1).Clip(tex_cx, tex_cy);
+
+		if (GLUploadBegin(texture, (size_t)(texture_rect.Area() + right.Area() + below.Area()) * 4)) {
+			GLUploadCopy(frame.data.data(), frame.Linesize(), texture_rect, 0, 0);
+			GLUploadClear(right);
+			GLUploadClear(below);
+			GLUploadEnd();
+
+			staging_valid = false;
+			texture_stale = false;
+			return;
+		}
+	}
+#endif
+
+	uint8_t *ptr;
+	uint32_t linesize;
+	if (!gs_texture_map(texture, &ptr, &linesize))
+		return;
+
+	/* Pooled textures can be larger than texture_rect */
+	CopyFrameRect(ptr, linesize, frame.data.data(), frame.Linesize(), texture_rect, 0, 0);
+	ClearFrameBorder(ptr, linesize, texture_rect.cx, texture_rect.cy, (int)gs_texture_get_width(texture),
+			 (int)gs_texture_get_height(texture));
+
+	gs_texture_unmap(texture);
+	staging_valid = true;
+	texture_stale = false;
+}
+
+void NotificationSource::UploadPendingFrame()
+{
+	const FrameMailbox::Frame *frame = frames.Acquire();
+
+	/* Unchanged paints never reach the mailbox, so a texture destroyed
+	 * while hidden is rebuilt from the last frame we already have */
+	if (!frame && !texture)
+		frame = frames.Current();
+	if (!frame || !frame->width || !frame->height)
+		return;
+
+	view_cx = frame->width;
+	view_cy = frame->height;
+
+	const FrameCoverage &coverage = frame->coverage;
+	const FrameAlpha alpha = coverage.Classify(frame->width, frame->height);
+
+	/* Without trimming the whole frame is uploaded and drawn, unless
+	 * there is nothing to draw at all */
+	const FrameRect bounds = trim_transparent || alpha == FrameAlpha::Transparent
+					 ? coverage.bounds
+					 : FrameRect(0, 0, frame->width, frame->height);
+	draw_rect = bounds;
+	draw_opaque = trim_transparent ? coverage.opaque : alpha == FrameAlpha::Opaque;
+
+	/* Nothing visible, the texture is brought up to date once there is
+	 * something to draw again */
+	if (bounds.Empty()) {
+		texture_stale = true;
+		return;
+	}
+
+	const FrameRect wanted = AlignedTextureRect(bounds, frame->width, frame->height);
+
+	if (texture && (!texture_rect.Contains(bounds) || wanted.Area() * 4 < texture_rect.Area() ||
+			!FrameRect(0, 0, frame->width, frame->height).Contains(texture_rect)))
+		ReleaseViewTexture();
+
+	if (!texture) {
+		/* Always filled through a full map of texture_rect so the
+		 * texture's staging memory holds all of it, which later
+		 * partial uploads build on */
+		texture_rect = wanted;
+		texture = TexturePoolAcquire(GS_BGRA, texture_rect.cx, texture_rect.cy);
+		texture_pooled = true;
+		if (texture)
+			UploadTextureRect(*frame);
+		return;
+	}
+
+	if (texture_stale || !UploadDirtyRects(*frame))
+		UploadTextureRect(*frame);
+}
+
+void NotificationSource::UploadPopupFrame()
+{
+	const FrameMailbox::Frame *frame = popup_frames.Acquire();
+	if (!frame || !frame->width || !frame->height)
+		return;
+
+	if (popup_texture && (gs_texture_get_width(popup_texture) != (uint32_t)frame->width ||
+			      gs_texture_get_height(popup_texture) != (uint32_t)frame->height)) {
+		gs_texture_destroy(popup_texture);
+		popup_texture = nullptr;
+	}
+
+	if (!popup_texture)
+		popup_texture = gs_texture_create(frame->width, frame->height, GS_BGRA, 1, nullptr, GS_DYNAMIC);
+	if (popup_texture)
+		gs_texture_set_image(popup_texture, frame->data.data(), frame->Linesize(), false);
 }
 
 extern void ProcessCef();
@@ -623,22 +1546,52 @@ void NotificationSource::Render()
 	flip = hwaccel;
 #endif
 
-	if (texture) {
+	/* A source shown in several views (preview, program, projectors,
+	 * multiview) is rendered several times per frame. Only the first
+	 * render of a frame uploads new frames and drives CEF, the others
+	 * just draw what is already there. */
+	const uint64_t frame_time = obs_get_video_frame_time();
+	const bool first_render = frame_time != last_render_time;
+	last_render_time = frame_time;
+
+	stats.render_calls++;
+	if (first_render) {
+		stats.render_frames++;
+		UploadPendingFrame();
+		UploadPopupFrame();
+	}
+
+	/* Software frames are trimmed down to their visible content. Fully
+	 * transparent ones are not drawn at all, and fully opaque ones simply
+	 * replace what is below them. */
+	const bool trimmed = !texture_rect.Empty();
+	const bool draw_view = texture && !(trimmed && draw_rect.Empty());
+	const bool opaque_view = trimmed && draw_opaque;
+	const bool draw_popup = popup_texture && popup_visible;
+
+	/* A baked animation plays below the view */
+	int baked_frame = -1;
+	const std::shared_ptr<BakedClip> baked = GetPlayingClip(frame_time, baked_frame);
+	FrameRect baked_rect;
+	gs_texture_t *const baked_texture = baked ? baked->GetTexture(baked_frame, baked_rect) : nullptr;
+
+	/* The view covers the viewport of the page. Pages rasterized below
+	 * their size are stretched back to it, frames are in physical pixels
+	 * while the viewport and popup positions are not. */
+	const FrameRect view = GetViewport();
+	const int frame_cx = trimmed ? view_cx : (texture ? (int)gs_texture_get_width(texture) : 0);
+	const int frame_cy = trimmed ? view_cy : (texture ? (int)gs_texture_get_height(texture) : 0);
+	const bool scaled = frame_cx > 0 && frame_cy > 0 && (frame_cx != view.cx || frame_cy != view.cy);
+	const float scale_x = scaled ? (float)view.cx / (float)frame_cx : 1.0f;
+	const float scale_y = scaled ? (float)view.cy / (float)frame_cy : 1.0f;
+
+	if (draw_view || draw_popup || baked_texture) {
 #ifdef __APPLE__
 		gs_effect_t *effect = obs_get_base_effect((hwaccel) ? OBS_EFFECT_DEFAULT_RECT : OBS_EFFECT_DEFAULT);
 #else
 		gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
 #endif
 
-		bool linear_sample = extra_texture == NULL;
-		gs_texture_t *draw_texture = texture;
-		if (!linear_sample && !obs_source_get_texcoords_centered(source)) {
-			gs_copy_texture(extra_texture, texture);
-			draw_texture = extra_texture;
-
-			linear_sample = true;
-		}
-
 		const bool previous = gs_framebuffer_srgb_enabled();
 		gs_enable_framebuffer_srgb(true);
 
@@ -646,57 +1599,154 @@ void NotificationSource::Render()
 		gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
 
 		gs_eparam_t *const image = gs_effect_get_param_by_name(effect, "image");
+		const uint32_t flip_flag = flip ? GS_FLIP_V : 0;
 
-		const char *tech;
-		if (linear_sample) {
-			gs_effect_set_texture_srgb(image, draw_texture);
-			tech = "Draw";
-		} else {
-			gs_effect_set_texture(image, draw_texture);
-			tech = "DrawSrgbDecompress";
+		gs_matrix_push();
+		gs_matrix_translate3f((float)view.x, (float)view.y, 0.0f);
+
+		if (baked_texture) {
+			gs_effect_set_texture_srgb(image, baked_texture);
+
+			gs_matrix_push();
+			gs_matrix_scale3f((float)view.cx / (float)baked->Width(), (float)view.cy / (float)baked->Height(),
+					  1.0f);
+			gs_matrix_translate3f((float)baked_rect.x, (float)baked_rect.y, 0.0f);
+			while (gs_effect_loop(effect, "Draw"))
+				gs_draw_sprite(baked_texture, 0, 0, 0);
+			gs_matrix_pop();
 		}
 
-		const uint32_t flip_flag = flip ? GS_FLIP_V : 0;
-		while (gs_effect_loop(effect, tech))
-			gs_draw_sprite(draw_texture, flip_flag, 0, 0);
+		if (draw_view) {
+			bool linear_sample = extra_texture == NULL;
+			gs_texture_t *draw_texture = texture;
+			if (!linear_sample && !obs_source_get_texcoords_centered(source)) {
+				/* The copy only has to be redone after a paint */
+				const uint64_t generation = content_generation;
+				if (extra_generation != generation) {
+					gs_copy_texture(extra_texture, texture);
+					extra_generation = generation;
+					stats.extra_copies++;
+				} else {
+					stats.extra_copies_skipped++;
+					stats.extra_copy_bytes_saved +=
+						(uint64_t)last_cx * last_cy * gs_get_format_bpp(last_format) / 8;
+				}
+				draw_texture = extra_texture;
+
+				linear_sample = true;
+			}
+
+			const char *tech;
+			if (linear_sample) {
+				gs_effect_set_texture_srgb(image, draw_texture);
+				tech = "Draw";
+			} else {
+				gs_effect_set_texture(image, draw_texture);
+				tech = "DrawSrgbDecompress";
+			}
 
+			if (opaque_view)
+				gs_enable_blending(false);
+
+			/* Bilinear is what the default effect does anyway */
+			gs_effect_t *view_effect = effect;
+			if (scaled && linear_sample && scale_filter != OBS_SCALE_BILINEAR &&
+			    effect == obs_get_base_effect(OBS_EFFECT_DEFAULT)) {
+				view_effect = obs_get_base_effect(scale_filter == OBS_SCALE_LANCZOS ? OBS_EFFECT_LANCZOS
+												    : OBS_EFFECT_BICUBIC);
+
+				struct vec2 base;
+				vec2_set(&base, (float)gs_texture_get_width(draw_texture),
+					 (float)gs_texture_get_height(draw_texture));
+				struct vec2 base_i;
+				vec2_set(&base_i, 1.0f / base.x, 1.0f / base.y);
+
+				gs_effect_set_vec2(gs_effect_get_param_by_name(view_effect, "base_dimension"), &base);
+				gs_effect_set_vec2(gs_effect_get_param_by_name(view_effect, "base_dimension_i"), &base_i);
+				gs_effect_set_texture_srgb(gs_effect_get_param_by_name(view_effect, "image"), draw_texture);
+			}
+
+			gs_matrix_push();
+			if (scaled)
+				gs_matrix_scale3f(scale_x, scale_y, 1.0f);
+
+			if (trimmed) {
+				gs_matrix_translate3f((float)draw_rect.x, (float)draw_rect.y, 0.0f);
+				while (gs_effect_loop(view_effect, tech))
+					gs_draw_sprite_subregion(draw_texture, flip_flag, draw_rect.x - texture_rect.x,
+								 draw_rect.y - texture_rect.y, draw_rect.cx,
+								 draw_rect.cy);
+			} else {
+				while (gs_effect_loop(view_effect, tech))
+					gs_draw_sprite(draw_texture, flip_flag, 0, 0);
+			}
+			gs_matrix_pop();
+		}
+
+		if (draw_popup) {
+			if (opaque_view)
+				gs_enable_blending(true);
+
+			gs_effect_set_texture_srgb(image, popup_texture);
+
+			gs_matrix_push();
+			gs_matrix_translate3f((float)popup_x, (float)popup_y, 0.0f);
+			if (scaled)
+				gs_matrix_scale3f(scale_x, scale_y, 1.0f);
+			while (gs_effect_loop(effect, "Draw"))
+				gs_draw_sprite(popup_texture, flip_flag, 0, 0);
+			gs_matrix_pop();
+		}
+
+		gs_matrix_pop();
 		gs_blend_state_pop();
 
 		gs_enable_framebuffer_srgb(previous);
 	}
 
+	if (first_render) {
 #if defined(NOTIFICATION_EXTERNAL_BEGIN_FRAME_ENABLED) && defined(ENABLE_BROWSER_SHARED_TEXTURE)
-	SignalBeginFrame();
+		SignalBeginFrame();
 #elif defined(ENABLE_NOTIFICATION_QT_LOOP)
-	ProcessCef();
+		ProcessCef();
 #endif
+	}
 }
 
-static void ExecuteOnNotification(NotificationFunc func, NotificationSource *bs)
+/* Events sent to a page on purpose wake it, the ones only relaying OBS state
+ * to every page do not */
+static void ExecuteOnNotification(NotificationFunc func, NotificationSource *bs, bool activity)
 {
-	lock_guard<mutex> lock(notification_list_mutex);
+	if (!bs)
+		return;
 
-	if (bs) {
-		NotificationSource *bsw = reinterpret_cast<NotificationSource *>(bs);
-		bsw->ExecuteOnNotification(func, true);
-	}
+	if (activity)
+		bs->NotifyActivity();
+	bs->ExecuteOnNotification(func, true);
+}
+
+/* Sources in the snapshot may be going away, the strong reference keeps
+ * them alive while the task is queued */
+static void ExecuteOnEntry(const NotificationFunc &func, const RegistryEntry &entry, bool activity)
+{
+	OBSSourceAutoRelease ref = obs_weak_source_get_source(entry.weak);
+	if (ref)
+		ExecuteOnNotification(func, entry.bs, activity);
 }
 
 static void ExecuteOnAllNotifications(NotificationFunc func)
 {
-	lock_guard<mutex> lock(notification_list_mutex);
+	CefRefPtr<RegistrySnapshot> registry = GetNotificationRegistry();
+	if (!registry)
+		return;
 
-	NotificationSource *bs = first_notification;
-	while (bs) {
-		NotificationSource *bsw = reinterpret_cast<NotificationSource *>(bs);
-		bsw->ExecuteOnNotification(func, true);
-		bs = bs->next;
-	}
+	for (const RegistryEntry &entry : registry->entries)
+		ExecuteOnEntry(func, entry, false);
 }
 
-void DispatchJSEvent(std::string eventName, std::string jsonString, NotificationSource *notification)
+static NotificationFunc JSEventFunc(const std::string &eventName, const std::string &jsonString)
 {
-	const auto jsEvent = [=](CefRefPtr<CefBrowser> cefNotification) {
+	return [=](CefRefPtr<CefBrowser> cefNotification) {
 		CefRefPtr<CefProcessMessage> msg = CefProcessMessage::Create("DispatchJSEvent");
 		CefRefPtr<CefListValue> args = msg->GetArgumentList();
 
@@ -704,9 +1754,30 @@ void DispatchJSEvent(std::string eventName, std::string jsonString, Notification
 		args->SetString(1, jsonString);
 		SendNotificationProcessMessage(cefNotification, PID_RENDERER, msg);
 	};
+}
+
+/* Broadcasts relay OBS state and are no activity of their own. Events for one
+ * source are, unless they only tell the page about the source itself. */
+void DispatchJSEvent(std::string eventName, std::string jsonString, NotificationSource *notification, bool activity)
+{
+	const NotificationFunc jsEvent = JSEventFunc(eventName, jsonString);
 
 	if (!notification)
 		ExecuteOnAllNotifications(jsEvent);
 	else
-		ExecuteOnNotification(jsEvent, notification);
+		ExecuteOnNotification(jsEvent, notification, activity);
+}
+
+/* Only to the sources matching every key that is not empty, to all of them
+ * if every key is. Each of them counts it as activity. */
+void DispatchJSEventTo(std::string eventName, std::string jsonString, const std::string &name, const std::string &url,
+		       const std::string &tag)
+{
+	CefRefPtr<RegistrySnapshot> registry = GetNotificationRegistry();
+	if (!registry)
+		return;
+
+	const NotificationFunc jsEvent = JSEventFunc(eventName, jsonString);
+	for (const RegistryEntry *entry : registry->Find(name, url, tag))
+		ExecuteOnEntry(jsEvent, *entry, true);
 }
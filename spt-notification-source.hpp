@@ -22,10 +22,18 @@
 
 #include "cef-headers.hpp"
 #include "notification-app.hpp"
+#include "notification-atomic-ref.hpp"
+#include "notification-bake.hpp"
+#include "notification-frame.hpp"
+#include "notification-future.hpp"
+#include "notification-texture-pool.hpp"
 #include <atomic>
 #include <functional>
+#include <map>
+#include <memory>
 #include <string>
 #include <mutex>
+#include <vector>
 
 #if CHROME_VERSION_BUILD < 4103
 #include <obs.hpp>
@@ -50,20 +58,91 @@ enum class ControlLevel : int {
 };
 inline constexpr ControlLevel DEFAULT_CONTROL_LEVEL = ControlLevel::ReadObs;
 
+/* Where a source is currently shown, used to cap its frame rate */
+enum class FrameRateTier : int {
+	Program,
+	Preview,
+	Hidden,
+};
+
+/* What part of the page the browser rasterizes */
+enum class ViewportMode : int {
+	Full,
+	Manual,
+	SceneCrop,
+};
+
+/* An interaction event waiting for the CEF thread. Moves and wheel events
+ * are merged into the event queued right before them when it is of the same
+ * kind, everything else is replayed as is and keeps the order around it. */
+struct InputEvent {
+	enum class Type : int {
+		Move,
+		Wheel,
+		Other,
+	};
+
+	Type type = Type::Other;
+	uint32_t modifiers = 0;
+	int32_t x = 0;
+	int32_t y = 0;
+	bool leave = false;
+	int x_delta = 0;
+	int y_delta = 0;
+	NotificationFunc func;
+	/* Of the oldest event merged into this one */
+	uint64_t queued = 0;
+};
+
 extern bool hwaccel;
 
-struct NotificationSource {
-	NotificationSource **p_prev_next = nullptr;
-	NotificationSource *next = nullptr;
+/* Per-source counters, readable through the "get_stats" proc handler */
+struct NotificationStats {
+	std::atomic<uint64_t> frames_painted = 0;
+	std::atomic<uint64_t> frames_unchanged = 0;
+	std::atomic<uint64_t> bytes_painted = 0;
+	std::atomic<uint64_t> bytes_skipped = 0;
+	std::atomic<uint64_t> render_calls = 0;
+	std::atomic<uint64_t> render_frames = 0;
+	std::atomic<uint64_t> extra_copies = 0;
+	std::atomic<uint64_t> extra_copies_skipped = 0;
+	std::atomic<uint64_t> extra_copy_bytes_saved = 0;
+	std::atomic<uint64_t> freezes = 0;
+	std::atomic<uint64_t> input_events = 0;
+	std::atomic<uint64_t> input_delivered = 0;
+	std::atomic<uint64_t> input_flushes = 0;
+
+	/* Time from queueing a task to it finishing, for every task run on
+	 * the browser, and the time callers actually spent blocked on one */
+	LatencyHistogram task_latency;
+	LatencyHistogram task_waits;
+	/* Time from an interaction event to its delivery to the browser, and
+	 * from the oldest delivered event to the next paint of the view */
+	LatencyHistogram input_delay;
+	LatencyHistogram input_to_paint;
 
+	/* Nanoseconds spent at each windowless frame rate */
+	std::mutex rate_mutex;
+	std::map<int, uint64_t> rate_time;
+
+	inline void AddRateTime(int fps, uint64_t ns)
+	{
+		std::lock_guard<std::mutex> lock(rate_mutex);
+		rate_time[fps] += ns;
+	}
+};
+
+struct NotificationSource {
 	obs_source_t *source = nullptr;
 
 	bool tex_sharing_avail = false;
 	bool create_notification = false;
-	std::recursive_mutex lockNotification;
-	CefRefPtr<CefBrowser> cefNotification;
+	/* Set on the CEF thread, read anywhere through GetNotification */
+	AtomicRefPtr<CefBrowser> cefNotification;
 
 	std::string url;
+	/* Free-form key for targeted event dispatch, see notification-registry.hpp */
+	std::string tag;
 	std::string css;
 	gs_texture_t *texture = nullptr;
 	gs_texture_t *extra_texture = nullptr;
@@ -71,6 +150,65 @@ struct NotificationSource {
 	uint32_t last_cy = 0;
 	gs_color_format last_format = GS_UNKNOWN;
 
+	/* Bumped for every new view frame or shared texture paint, so work
+	 * derived from the texture is only redone when its content changed */
+	std::atomic<uint64_t> content_generation = 1;
+	/* content_generation that extra_texture holds a copy of, 0 if none */
+	uint64_t extra_generation = 0;
+
+	/* Frames painted by CEF (software path), uploaded in Render. The
+	 * texture only holds texture_rect of the frame and only draw_rect of
+	 * it is drawn. */
+	FrameMailbox frames;
+	FrameRect texture_rect;
+	FrameRect draw_rect;
+	bool draw_opaque = false;
+	bool texture_stale = false;
+	bool texture_pooled = false;
+	/* Video frame time of the last Render, to tell apart the first view
+	 * of a frame from further views of the same frame */
+	uint64_t last_render_time = 0;
+	/* The staging memory behind gs_texture_map matches the texture */
+	bool staging_valid = false;
+
+	/* <select> dropdowns and other popup widgets, drawn over the view */
+	FrameMailbox popup_frames;
+	gs_texture_t *popup_texture = nullptr;
+	std::atomic<bool> popup_visible = false;
+	std::atomic<int> popup_x = 0;
+	std::atomic<int> popup_y = 0;
+	FrameTileHasher tile_hasher;
+	NotificationStats stats;
+
+	/* Baked animations by template key. The page records an animation
+	 * once, later plays of it are drawn from the clip below the view,
+	 * which is left with only the dynamic parts of the page. Clips are
+	 * never destroyed with bake_mutex held, the last reference may have
+	 * to enter the graphics context to free textures. */
+	std::mutex bake_mutex;
+	std::map<std::string, std::shared_ptr<BakedClip>> baked_clips;
+	std::shared_ptr<BakedClip> bake_playing;
+	std::string bake_playing_key;
+	uint64_t bake_play_start = 0;
+	/* Graphics thread, the only clip with frames uploaded */
+	std::shared_ptr<BakedClip> bake_uploaded;
+	/* CEF thread */
+	std::shared_ptr<BakedClip> bake_recording;
+	std::string bake_recording_key;
+
+	/* Input coalescing: interaction events wait in input_events until the
+	 * one flush task queued for them runs on the CEF thread */
+	std::mutex input_mutex;
+	std::vector<InputEvent> input_events;
+	bool input_flush_queued = false;
+	/* CEF thread */
+	std::vector<InputEvent> input_batch;
+	/* Queue time of the oldest event delivered since the last paint */
+	std::atomic<uint64_t> input_unpainted = 0;
+
+	/* Alpha of the last painted view frame, set by the CEF thread */
+	std::atomic<FrameAlpha> frame_alpha = FrameAlpha::Transparent;
+
 #ifdef ENABLE_BROWSER_SHARED_TEXTURE
 #ifdef _WIN32
 	void *last_handle = INVALID_HANDLE_VALUE;
@@ -89,6 +227,82 @@ struct NotificationSource {
 	bool is_local = false;
 	bool first_update = true;
 	bool reroute_audio = true;
+	int partial_upload_threshold = 0;
+	bool change_detection = true;
+	bool trim_transparent = true;
+
+	/* Adaptive frame rate: after adaptive_idle_frames video frames without
+	 * a paint, JS event or input the browser drops to adaptive_min_fps */
+	bool adaptive_fps = false;
+	int adaptive_idle_frames = 60;
+	int adaptive_min_fps = 5;
+	int adaptive_max_fps = 0;
+	int quiet_frames = 0;
+	uint64_t seen_generation = 0;
+	uint64_t rate_time = 0;
+	/* Windowless frame rate the browser runs at, 0 without a browser or
+	 * when frames are requested through external begin frames */
+	std::atomic<int> current_fps = 0;
+	std::atomic<bool> activity = false;
+
+	/* Idle freeze: after idle_freeze_seconds without a paint, JS event,
+	 * input or settings change the page is hidden and its lifecycle
+	 * frozen, until activity thaws it again */
+	bool idle_freeze = false;
+	int idle_freeze_seconds = 30;
+	uint64_t active_time = 0;
+	std::atomic<bool> frozen = false;
+
+	/* Frame rate caps for sources that are not live on program, the tier
+	 * follows the show/hide and activate/deactivate callbacks */
+	bool frame_rate_tiers = false;
+	int preview_fps = 15;
+	int hidden_fps = 1;
+	std::atomic<bool> is_active = false;
+	std::atomic<FrameRateTier> tier = FrameRateTier::Hidden;
+
+	/* Showing, but off-canvas, covered or at zero opacity in every scene
+	 * it is shown in. The page is hidden as if the source was. */
+	bool visibility_culling = false;
+	std::atomic<bool> culled = false;
+
+	/* Auto-resolution: the page is rasterized at the largest size any of
+	 * its items is drawn at on the canvas, never above width/height. Only
+	 * the device scale factor changes, the page layout and the size of
+	 * the source stay the same. */
+	bool auto_resolution = false;
+	float auto_scale = 1.0f;
+	int auto_scale_frames = 0;
+	/* Fixed scale on top of that, views rasterized below their size are
+	 * stretched back up with scale_filter */
+	float render_scale = 1.0f;
+	obs_scale_type scale_filter = OBS_SCALE_BILINEAR;
+	/* Lag governor: while OBS lags, the source is throttled by
+	 * governor_step, see notification-governor.hpp */
+	bool lag_governor = false;
+	int governor_step = 0;
+	/* Device scale factor the browser rasterizes at, read by the CEF
+	 * thread */
+	std::atomic<float> view_scale = 1.0f;
+	/* Size of the last uploaded software frame, in physical pixels */
+	int view_cx = 0;
+	int view_cy = 0;
+
+	/* The page is laid out at width/height, but the view only covers
+	 * viewport of it, which is all that is painted and uploaded. The
+	 * source keeps its size and draws the view at the viewport offset,
+	 * so scene item crop still lines up. Empty for the whole page. */
+	ViewportMode viewport_mode = ViewportMode::Full;
+	std::mutex viewport_mutex;
+	FrameRect viewport;
+
+	/* Software path driven by the OBS clock: CEF only paints when Tick
+	 * sends it a begin frame, once every begin_frame_interval frames */
+	bool external_begin_frame = false;
+	int begin_frame_divider = 1;
+	std::atomic<bool> begin_frame_driven = false;
+	std::atomic<int> begin_frame_interval = 1;
+	int begin_frame_count = 0;
 	std::atomic<bool> destroying = false;
 	ControlLevel webpage_control_level = DEFAULT_CONTROL_LEVEL;
 #if defined(NOTIFICATION_EXTERNAL_BEGIN_FRAME_ENABLED) && defined(ENABLE_BROWSER_SHARED_TEXTURE)
@@ -96,20 +310,44 @@ struct NotificationSource {
 #endif
 	bool is_showing = false;
 
-	inline void DestroyTextures()
+	/* Must be called inside the graphics context */
+	inline void ReleaseViewTexture()
+	{
+		if (texture) {
+			if (texture_pooled)
+				TexturePoolRelease(texture);
+			else
+				gs_texture_destroy(texture);
+			texture = nullptr;
+		}
+		texture_pooled = false;
+		texture_rect = FrameRect();
+		texture_stale = false;
+		staging_valid = false;
+	}
+
+	/* Must be called inside the graphics context */
+	inline void ReleaseTextures()
 	{
-		obs_enter_graphics();
 		if (extra_texture) {
 			gs_texture_destroy(extra_texture);
 			extra_texture = nullptr;
+			extra_generation = 0;
 			last_cx = 0;
 			last_cy = 0;
 			last_format = GS_UNKNOWN;
 		}
-		if (texture) {
-			gs_texture_destroy(texture);
-			texture = nullptr;
+		ReleaseViewTexture();
+		if (popup_texture) {
+			gs_texture_destroy(popup_texture);
+			popup_texture = nullptr;
 		}
+	}
+
+	inline void DestroyTextures()
+	{
+		obs_enter_graphics();
+		ReleaseTextures();
 		obs_leave_graphics();
 	}
 
@@ -118,6 +356,7 @@ struct NotificationSource {
 	bool CreateNotification();
 	void DestroyNotification();
 	void ExecuteOnNotification(NotificationFunc func, bool async = false);
+	NotificationFuture QueueOnNotification(NotificationFunc func);
 
 	/* ---------------------------- */
 
@@ -128,7 +367,30 @@ struct NotificationSource {
 
 	void Update(obs_data_t *settings = nullptr);
 	void Tick();
+	int FullFrameRate() const;
+	void UpdateFrameRate();
+	inline void NotifyActivity()
+	{
+		activity = true;
+		if (frozen)
+			Thaw();
+	}
+	void Freeze();
+	void Thaw();
+	inline void UpdateTier()
+	{
+		if (culled || (!is_active && !is_showing))
+			tier = FrameRateTier::Hidden;
+		else if (is_active)
+			tier = FrameRateTier::Program;
+		else
+			tier = FrameRateTier::Preview;
+	}
 	void Render();
+	void UploadPendingFrame();
+	void UploadPopupFrame();
+	void UploadTextureRect(const FrameMailbox::Frame &frame);
+	bool UploadDirtyRects(const FrameMailbox::Frame &frame);
 #if CHROME_VERSION_BUILD < 4103
 	void ClearAudioStreams();
 	void EnumAudioStreams(obs_source_enum_proc_t cb, void *param);
@@ -142,9 +404,29 @@ struct NotificationSource {
 	void SendMouseWheel(const struct obs_mouse_event *event, int x_delta, int y_delta);
 	void SendFocus(bool focus);
 	void SendKeyClick(const struct obs_key_event *event, bool key_up);
+	void QueueInput(InputEvent &&event);
+	void FlushInput();
+	void InputPainted();
 	void SetShowing(bool showing);
+	void SetCulled(bool cull);
+	void SetAutoScale(float scale);
+	void UpdateViewScale();
+	void SetGovernorStep(int step);
+	void StartBake(const std::string &key);
+	void StopBake();
+	void RecordBakeFrame(const uint8_t *buffer, int width, int height, const FrameRect &bounds);
+	bool PlayBaked(const std::string &key);
+	std::shared_ptr<BakedClip> GetPlayingClip(uint64_t frame_time, int &frame);
+	void SetViewport(const FrameRect &rect);
+	FrameRect GetViewport();
+	void ApplyViewport(CefRefPtr<CefBrowser> cefNotification);
+	void SetPageVisible(bool visible);
 	void SetActive(bool active);
 	void Refresh();
+	std::string GetStatsJson();
+
+	inline FrameAlpha GetFrameAlpha() const { return frame_alpha; }
+	inline bool IsEmpty() const { return frame_alpha == FrameAlpha::Transparent; }
 
 #if defined(NOTIFICATION_EXTERNAL_BEGIN_FRAME_ENABLED) && defined(ENABLE_BROWSER_SHARED_TEXTURE)
 	inline void SignalBeginFrame();
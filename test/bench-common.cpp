@@ -0,0 +1,198 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+#include "bench-common.hpp"
+#include <obs-module.h>
+#include <util/platform.h>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <obs-nix-platform.h>
+#include <X11/Xlib.h>
+#endif
+
+#ifdef __linux__
+static Display *display = nullptr;
+#endif
+
+bool BenchParseOptions(int argc, char **argv, BenchOptions &options, int &first_arg)
+{
+	options.module = NOTIFICATION_BENCH_MODULE;
+
+	int i = 1;
+	for (; i < argc; i++) {
+		if (strcmp(argv[i], "--module") == 0 && i + 1 < argc) {
+			options.module = argv[++i];
+		} else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+			options.seconds = atoi(argv[++i]);
+			if (options.seconds <= 0)
+				return false;
+		} else if (strncmp(argv[i], "--", 2) == 0) {
+			return false;
+		} else {
+			break;
+		}
+	}
+
+	first_arg = i;
+	return true;
+}
+
+bool BenchStartup(const BenchOptions &options, uint32_t cx, uint32_t cy)
+{
+#ifdef __linux__
+	display = XOpenDisplay(nullptr);
+	if (!display) {
+		fprintf(stderr, "Could not open the X display\n");
+		return false;
+	}
+	obs_set_nix_platform(OBS_NIX_PLATFORM_X11_EGL);
+	obs_set_nix_platform_display(display);
+#endif
+
+	if (!obs_startup("en-US", nullptr, nullptr)) {
+		fprintf(stderr, "Could not start libobs\n");
+		return false;
+	}
+
+	struct obs_video_info ovi = {};
+#ifdef _WIN32
+	ovi.graphics_module = "libobs-d3d11";
+#else
+	ovi.graphics_module = "libobs-opengl";
+#endif
+	ovi.fps_num = 60;
+	ovi.fps_den = 1;
+	ovi.base_width = cx;
+	ovi.base_height = cy;
+	ovi.output_width = cx;
+	ovi.output_height = cy;
+	ovi.output_format = VIDEO_FORMAT_NV12;
+	ovi.colorspace = VIDEO_CS_709;
+	ovi.range = VIDEO_RANGE_PARTIAL;
+	ovi.gpu_conversion = true;
+	ovi.scale_type = OBS_SCALE_BICUBIC;
+	if (obs_reset_video(&ovi) != OBS_VIDEO_SUCCESS) {
+		fprintf(stderr, "Could not start video\n");
+		return false;
+	}
+
+	struct obs_audio_info oai = {48000, SPEAKERS_STEREO};
+	if (!obs_reset_audio(&oai)) {
+		fprintf(stderr, "Could not start audio\n");
+		return false;
+	}
+
+	obs_module_t *module = nullptr;
+	if (obs_open_module(&module, options.module.c_str(), NOTIFICATION_BENCH_MODULE_DATA) != MODULE_SUCCESS ||
+	    !obs_init_module(module)) {
+		fprintf(stderr, "Could not load %s\n", options.module.c_str());
+		return false;
+	}
+	obs_post_load_modules();
+	return true;
+}
+
+void BenchShutdown()
+{
+	obs_shutdown();
+
+#ifdef __linux__
+	if (display)
+		XCloseDisplay(display);
+	display = nullptr;
+#endif
+}
+
+obs_source_t *BenchCreateSource(const char *page, int cx, int cy)
+{
+	std::string path = NOTIFICATION_BENCH_DATA;
+	path += "/";
+	path += page;
+
+	obs_data_t *settings = obs_data_create();
+	obs_data_set_bool(settings, "is_local_file", true);
+	obs_data_set_string(settings, "local_file", path.c_str());
+	obs_data_set_int(settings, "width", cx);
+	obs_data_set_int(settings, "height", cy);
+	obs_data_set_bool(settings, "fps_custom", true);
+	obs_data_set_int(settings, "fps", 60);
+
+	obs_source_t *source = obs_source_create("notification_source", page, settings, nullptr);
+	obs_data_release(settings);
+	if (!source) {
+		fprintf(stderr, "Could not create a notification source\n");
+		return nullptr;
+	}
+
+	obs_source_inc_showing(source);
+
+	QElapsedTimer timer;
+	timer.start();
+	while (BenchGetStats(source).value("frames_painted", 0) == 0) {
+		if (timer.elapsed() > 15000) {
+			fprintf(stderr, "%s did not paint\n", path.c_str());
+			BenchReleaseSource(source);
+			return nullptr;
+		}
+		BenchRun(10);
+	}
+
+	return source;
+}
+
+void BenchReleaseSource(obs_source_t *source)
+{
+	obs_source_dec_showing(source);
+	obs_source_release(source);
+}
+
+void BenchRun(int ms)
+{
+	QElapsedTimer timer;
+	timer.start();
+	while (timer.elapsed() < ms) {
+		QCoreApplication::processEvents(QEventLoop::AllEvents, 5);
+		os_sleep_ms(1);
+	}
+}
+
+nlohmann::json BenchGetStats(obs_source_t *source)
+{
+	calldata_t cd = {};
+	nlohmann::json json = nlohmann::json::object();
+
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
+	if (proc_handler_call(ph, "get_stats", &cd)) {
+		const char *str = nullptr;
+		if (calldata_get_string(&cd, "json", &str) && str)
+			json = nlohmann::json::parse(str, nullptr, false);
+	}
+
+	calldata_free(&cd);
+	return json.is_discarded() ? nlohmann::json::object() : json;
+}
+
+uint64_t BenchStatDelta(const nlohmann::json &before, const nlohmann::json &after, const char *name)
+{
+	return after.value(name, (uint64_t)0) - before.value(name, (uint64_t)0);
+}
@@ -0,0 +1,51 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+#pragma once
+
+/* Shared setup of the benchmarks. They run the real plugin inside a bare
+ * libobs with the OpenGL renderer and no outputs, and pump the CEF message
+ * loop from Qt like the frontend does. They need a display, so run them under
+ * xvfb-run on headless machines. */
+
+#include <obs.h>
+#include <nlohmann/json.hpp>
+#include <string>
+
+struct BenchOptions {
+	/* Plugin module to load, defaults to the one from this build. Point it
+	 * at an older build to compare against it. */
+	std::string module;
+	int seconds = 5;
+};
+
+bool BenchParseOptions(int argc, char **argv, BenchOptions &options, int &first_arg);
+
+bool BenchStartup(const BenchOptions &options, uint32_t cx, uint32_t cy);
+void BenchShutdown();
+
+/* Creates a shown notification source for a page in test/data, and waits
+ * until it has painted. Release it with BenchReleaseSource. */
+obs_source_t *BenchCreateSource(const char *page, int cx, int cy);
+void BenchReleaseSource(obs_source_t *source);
+
+/* Processes Qt events, which also runs the CEF message loop, for ms */
+void BenchRun(int ms);
+
+nlohmann::json BenchGetStats(obs_source_t *source);
+uint64_t BenchStatDelta(const nlohmann::json &before, const nlohmann::json &after, const char *name);
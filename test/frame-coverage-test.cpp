@@ -0,0 +1,130 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/* Checks the alpha coverage scans against a plain per-pixel reference.
+ *
+ * ScanFrameCoverage has to match the reference exactly. UpdateFrameCoverage
+ * only rescans dirty rects, so it may report looser bounds or less opacity
+ * than a full scan, but never tighter bounds or more opacity, which would
+ * cut off or wrongly skip blending visible content. */
+
+#include "notification-frame.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static constexpr int WIDTH = 97;
+static constexpr int HEIGHT = 61;
+static constexpr int FRAMES = 20000;
+
+static bool SameCoverage(const FrameCoverage &a, const FrameCoverage &b)
+{
+	return a.bounds.x == b.bounds.x && a.bounds.y == b.bounds.y && a.bounds.cx == b.bounds.cx &&
+	       a.bounds.cy == b.bounds.cy && a.opaque == b.opaque;
+}
+
+static FrameCoverage ReferenceCoverage(const std::vector<uint8_t> &buffer, int width, int height)
+{
+	int min_x = width, min_y = height, max_x = -1, max_y = -1;
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			if (!buffer[((size_t)y * width + x) * 4 + 3])
+				continue;
+			min_x = x < min_x ? x : min_x;
+			min_y = y < min_y ? y : min_y;
+			max_x = x > max_x ? x : max_x;
+			max_y = y > max_y ? y : max_y;
+		}
+	}
+
+	FrameCoverage coverage;
+	if (max_x < 0)
+		return coverage;
+
+	coverage.bounds = FrameRect(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
+	coverage.opaque = true;
+	for (int y = min_y; y <= max_y && coverage.opaque; y++) {
+		for (int x = min_x; x <= max_x; x++) {
+			if (buffer[((size_t)y * width + x) * 4 + 3] != 0xFF) {
+				coverage.opaque = false;
+				break;
+			}
+		}
+	}
+	return coverage;
+}
+
+/* Fills rect with transparent, opaque or mostly opaque pixels */
+static void Paint(std::vector<uint8_t> &buffer, int width, const FrameRect &rect)
+{
+	const int mode = rand() % 3;
+	for (int y = rect.y; y < rect.Bottom(); y++) {
+		for (int x = rect.x; x < rect.x + rect.cx; x++) {
+			uint8_t *px = &buffer[((size_t)y * width + x) * 4];
+			px[0] = (uint8_t)rand();
+			px[1] = (uint8_t)rand();
+			px[2] = (uint8_t)rand();
+			px[3] = mode == 0 ? 0 : mode == 1 ? 0xFF : (rand() % 4 ? 0xFF : (uint8_t)rand());
+		}
+	}
+}
+
+int main()
+{
+	srand(1);
+
+	std::vector<uint8_t> buffer((size_t)WIDTH * HEIGHT * 4, 0);
+	FrameCoverage coverage = ScanFrameCoverage(buffer.data(), WIDTH, HEIGHT, WIDTH * 4);
+	int scan_errors = 0;
+	int update_errors = 0;
+	int exact = 0;
+
+	for (int i = 0; i < FRAMES; i++) {
+		DirtyRegion dirty;
+		const int rects = 1 + rand() % 3;
+		for (int r = 0; r < rects; r++) {
+			const int x = rand() % WIDTH;
+			const int y = rand() % HEIGHT;
+			FrameRect rect(x, y, 1 + rand() % (WIDTH - x), 1 + rand() % (HEIGHT - y));
+			if (rand() % 8 == 0)
+				rect = FrameRect(0, 0, WIDTH, HEIGHT);
+
+			Paint(buffer, WIDTH, rect);
+			dirty.Add(rect);
+		}
+
+		const FrameCoverage expected = ReferenceCoverage(buffer, WIDTH, HEIGHT);
+		const FrameCoverage scanned = ScanFrameCoverage(buffer.data(), WIDTH, HEIGHT, WIDTH * 4);
+		const FrameCoverage updated =
+			UpdateFrameCoverage(coverage, buffer.data(), WIDTH, HEIGHT, WIDTH * 4, dirty);
+
+		if (!SameCoverage(scanned, expected))
+			scan_errors++;
+
+		if (!updated.bounds.Contains(expected.bounds) || (updated.opaque && !SameCoverage(updated, expected)))
+			update_errors++;
+		else if (SameCoverage(updated, expected))
+			exact++;
+
+		coverage = updated;
+	}
+
+	printf("%d frames: %d scan errors, %d update errors, %d updates exact\n", FRAMES, scan_errors, update_errors,
+	       exact);
+	return scan_errors || update_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
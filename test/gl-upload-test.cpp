@@ -0,0 +1,195 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/* Streams random partial copies and clears through the mapped upload ring
+ * and compares the texture with the same operations done on the CPU.
+ *
+ * Runs on a surfaceless EGL context, so it needs no display. On Mesa that is
+ * llvmpipe when no GPU is available, or when forced with
+ * LIBGL_ALWAYS_SOFTWARE=1. With --fallback it instead checks that the ring
+ * reports itself unavailable, run it with
+ * MESA_GL_VERSION_OVERRIDE=3.3 MESA_EXTENSION_OVERRIDE=-GL_ARB_buffer_storage
+ * to hide buffer storage from the driver.
+ *
+ * Exits with 77, which ctest reports as skipped, without a usable context. */
+
+#include "notification-gl-upload.hpp"
+#include <util/base.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glcorearb.h>
+#include <algorithm>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static constexpr int SKIP = 77;
+static constexpr int TEX_CX = 300;
+static constexpr int TEX_CY = 200;
+static constexpr int FRAME_CX = 400;
+static constexpr int FRAME_CY = 300;
+static constexpr int UPLOADS = 2000;
+
+/* The few libobs functions the upload ring uses, the test runs without a
+ * libobs graphics subsystem */
+struct gs_texture {
+	GLuint id;
+};
+
+int gs_get_device_type(void)
+{
+	return GS_DEVICE_OPENGL;
+}
+
+void *gs_texture_get_obj(gs_texture_t *tex)
+{
+	return &tex->id;
+}
+
+void blog(int, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+	printf("\n");
+}
+
+static bool CreateContext()
+{
+	auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (!getPlatformDisplay)
+		return false;
+
+	EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr) || !eglBindAPI(EGL_OPENGL_API))
+		return false;
+
+	const EGLint attribs[] = {EGL_CONTEXT_MAJOR_VERSION,
+				  3,
+				  EGL_CONTEXT_MINOR_VERSION,
+				  3,
+				  EGL_CONTEXT_OPENGL_PROFILE_MASK,
+				  EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+				  EGL_NONE};
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+	if (context == EGL_NO_CONTEXT)
+		return false;
+
+	return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+}
+
+static int RandomRange(int max)
+{
+	return rand() % max;
+}
+
+int main(int argc, char **argv)
+{
+	const bool fallback = argc > 1 && strcmp(argv[1], "--fallback") == 0;
+
+	if (!CreateContext()) {
+		printf("No surfaceless EGL context, skipping\n");
+		return SKIP;
+	}
+
+	gs_texture_t tex;
+	glGenTextures(1, &tex.id);
+	glBindTexture(GL_TEXTURE_2D, tex.id);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, TEX_CX, TEX_CY, 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+
+	if (fallback) {
+		const bool available = GLUploadAvailable();
+		const bool began = GLUploadBegin(&tex, 1024);
+		printf("available %d, upload started %d\n", available, began);
+		return available || began ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	if (!GLUploadAvailable()) {
+		printf("Upload ring unavailable\n");
+		return EXIT_FAILURE;
+	}
+
+	/* Uploads have to leave the bindings of the caller alone */
+	GLuint other = 0;
+	glGenTextures(1, &other);
+	glBindTexture(GL_TEXTURE_2D, other);
+
+	srand(1);
+	std::vector<uint8_t> frame((size_t)FRAME_CX * FRAME_CY * 4);
+	std::vector<uint8_t> expected((size_t)TEX_CX * TEX_CY * 4, 0);
+	int binding_errors = 0;
+
+	for (int i = 0; i < UPLOADS; i++) {
+		for (uint8_t &byte : frame)
+			byte = (uint8_t)rand();
+
+		FrameRect copy = FrameRect(RandomRange(FRAME_CX), RandomRange(FRAME_CY), 1 + RandomRange(120),
+					   1 + RandomRange(120))
+					 .Clip(FRAME_CX, FRAME_CY);
+		const int dst_x = RandomRange(TEX_CX);
+		const int dst_y = RandomRange(TEX_CY);
+		copy.cx = std::min(copy.cx, TEX_CX - dst_x);
+		copy.cy = std::min(copy.cy, TEX_CY - dst_y);
+
+		const FrameRect clear =
+			FrameRect(RandomRange(TEX_CX), RandomRange(TEX_CY), 1 + RandomRange(20), 1 + RandomRange(20))
+				.Clip(TEX_CX, TEX_CY);
+
+		/* Every so often reserve far more than is written, which grows
+		 * the ring and makes later uploads wrap around and wait for
+		 * the fences of older ones */
+		size_t bytes = (size_t)(copy.Area() + clear.Area()) * 4;
+		if (i % 100 == 0)
+			bytes += 40 * 1024 * 1024;
+
+		if (!GLUploadBegin(&tex, bytes)) {
+			printf("Upload %d could not be started\n", i);
+			return EXIT_FAILURE;
+		}
+		GLUploadCopy(frame.data(), FRAME_CX * 4, copy, dst_x, dst_y);
+		GLUploadClear(clear);
+		GLUploadEnd();
+
+		GLint bound = 0;
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+		if ((GLuint)bound != other)
+			binding_errors++;
+
+		for (int y = 0; y < copy.cy; y++)
+			memcpy(&expected[((size_t)(dst_y + y) * TEX_CX + dst_x) * 4],
+			       &frame[((size_t)(copy.y + y) * FRAME_CX + copy.x) * 4], (size_t)copy.cx * 4);
+		for (int y = 0; y < clear.cy; y++)
+			memset(&expected[((size_t)(clear.y + y) * TEX_CX + clear.x) * 4], 0, (size_t)clear.cx * 4);
+	}
+
+	std::vector<uint8_t> result(expected.size());
+	glBindTexture(GL_TEXTURE_2D, tex.id);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_BGRA, GL_UNSIGNED_BYTE, result.data());
+
+	const GLenum error = glGetError();
+	const bool match = result == expected;
+	printf("%d uploads: texture %s, %d binding errors, GL error 0x%x\n", UPLOADS, match ? "matches" : "differs",
+	       binding_errors, error);
+
+	GLUploadShutdown();
+	return match && !binding_errors && error == GL_NO_ERROR ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,212 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/* Measures the cursor-to-paint latency of an interacted notification source.
+ *
+ * A thread moves the mouse across the page at a fixed rate and remembers when
+ * it sent each x position. The page draws a red bar at the mouse position.
+ * Every rendered OBS frame is read back, and when the bar shows up at a new
+ * position the time since that position was sent is recorded. That is the
+ * full path from the interaction event to the frame OBS outputs, so it can be
+ * compared between builds with --module, for example against a build from
+ * before interaction events were coalesced. */
+
+#include "bench-common.hpp"
+#include <util/platform.h>
+#include <QApplication>
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+static constexpr uint32_t BASE_WIDTH = 1280;
+static constexpr uint32_t BASE_HEIGHT = 720;
+static constexpr int SOURCE_WIDTH = 800;
+static constexpr int SOURCE_HEIGHT = 64;
+static constexpr int MARKER_WIDTH = 16;
+static constexpr int POSITIONS = SOURCE_WIDTH - MARKER_WIDTH;
+
+struct CursorLatency {
+	obs_source_t *source = nullptr;
+	gs_texrender_t *texrender = nullptr;
+	gs_stagesurf_t *stagesurf = nullptr;
+
+	std::atomic<uint64_t> sent_ns[POSITIONS] = {};
+	std::atomic<bool> recording = false;
+	std::vector<uint64_t> latencies;
+	uint64_t missing = 0;
+	int last_x = -1;
+};
+
+static int FindMarker(const uint8_t *data, uint32_t linesize)
+{
+	/* BGRA, the bar covers the full height so any row works */
+	const uint8_t *row = data + (size_t)linesize * (SOURCE_HEIGHT / 2);
+	for (int x = 0; x < POSITIONS; x++) {
+		const uint8_t *pixel = row + x * 4;
+		if (pixel[2] > 192 && pixel[1] < 64 && pixel[0] < 64 && pixel[3] > 192)
+			return x;
+	}
+
+	return -1;
+}
+
+static void ReadBack(void *param, uint32_t, uint32_t)
+{
+	CursorLatency *bench = (CursorLatency *)param;
+
+	gs_texrender_reset(bench->texrender);
+	if (!gs_texrender_begin(bench->texrender, SOURCE_WIDTH, SOURCE_HEIGHT))
+		return;
+
+	struct vec4 clear_color;
+	vec4_zero(&clear_color);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+	gs_ortho(0.0f, (float)SOURCE_WIDTH, 0.0f, (float)SOURCE_HEIGHT, -100.0f, 100.0f);
+	obs_source_video_render(bench->source);
+	gs_texrender_end(bench->texrender);
+
+	/* Mapping right away stalls until the GPU is done, which is the point:
+	 * the time taken is when this frame really had the bar in it */
+	gs_stage_texture(bench->stagesurf, gs_texrender_get_texture(bench->texrender));
+
+	uint8_t *data;
+	uint32_t linesize;
+	if (!gs_stagesurface_map(bench->stagesurf, &data, &linesize))
+		return;
+
+	const int x = FindMarker(data, linesize);
+	gs_stagesurface_unmap(bench->stagesurf);
+	const uint64_t now = os_gettime_ns();
+
+	if (!bench->recording)
+		return;
+
+	if (x < 0) {
+		bench->missing++;
+		return;
+	}
+
+	if (x == bench->last_x)
+		return;
+	bench->last_x = x;
+
+	const uint64_t sent = bench->sent_ns[x];
+	if (sent && sent < now)
+		bench->latencies.push_back(now - sent);
+}
+
+static void MoveMouse(CursorLatency *bench, uint64_t interval_ns, const std::atomic<bool> &stop, uint64_t &events)
+{
+	uint64_t next = os_gettime_ns();
+	int x = 0;
+
+	while (!stop) {
+		struct obs_mouse_event event = {};
+		event.x = x;
+		event.y = SOURCE_HEIGHT / 2;
+
+		bench->sent_ns[x] = os_gettime_ns();
+		obs_source_send_mouse_move(bench->source, &event, false);
+		events++;
+
+		x = (x + 1) % POSITIONS;
+		next += interval_ns;
+		os_sleepto_ns(next);
+	}
+}
+
+static double Percentile(const std::vector<uint64_t> &sorted, double p)
+{
+	const size_t i = std::min(sorted.size() - 1, (size_t)(p * (double)(sorted.size() - 1) + 0.5));
+	return (double)sorted[i] / 1000000.0;
+}
+
+int main(int argc, char **argv)
+{
+	QApplication app(argc, argv);
+
+	BenchOptions options;
+	int first_arg = 1;
+	if (!BenchParseOptions(argc, argv, options, first_arg) || argc - first_arg > 1) {
+		fprintf(stderr, "usage: %s [--module path] [--seconds n] [mouse rate in Hz]\n", argv[0]);
+		return 2;
+	}
+
+	const int rate = first_arg < argc ? atoi(argv[first_arg]) : 1000;
+	if (rate <= 0)
+		return 2;
+
+	if (!BenchStartup(options, BASE_WIDTH, BASE_HEIGHT))
+		return 1;
+
+	CursorLatency bench;
+	bench.source = BenchCreateSource("bench-cursor.html", SOURCE_WIDTH, SOURCE_HEIGHT);
+	if (!bench.source) {
+		BenchShutdown();
+		return 1;
+	}
+
+	obs_enter_graphics();
+	bench.texrender = gs_texrender_create(GS_BGRA, GS_ZS_NONE);
+	bench.stagesurf = gs_stagesurface_create(SOURCE_WIDTH, SOURCE_HEIGHT, GS_BGRA);
+	obs_leave_graphics();
+
+	std::atomic<bool> stop = false;
+	uint64_t events = 0;
+	std::thread mouse(MoveMouse, &bench, 1000000000ULL / rate, std::cref(stop), std::ref(events));
+
+	obs_add_main_render_callback(ReadBack, &bench);
+	BenchRun(1000);
+
+	const nlohmann::json before = BenchGetStats(bench.source);
+	bench.recording = true;
+	BenchRun(options.seconds * 1000);
+
+	obs_remove_main_render_callback(ReadBack, &bench);
+	stop = true;
+	mouse.join();
+	const nlohmann::json after = BenchGetStats(bench.source);
+
+	obs_enter_graphics();
+	gs_stagesurface_destroy(bench.stagesurf);
+	gs_texrender_destroy(bench.texrender);
+	obs_leave_graphics();
+
+	std::vector<uint64_t> &latencies = bench.latencies;
+	std::sort(latencies.begin(), latencies.end());
+
+	printf("mouse rate %d Hz, %llu moves sent, %zu positions painted, %llu frames without the bar\n", rate,
+	       (unsigned long long)events, latencies.size(), (unsigned long long)bench.missing);
+	if (!latencies.empty())
+		printf("cursor to paint ms: min %.2f p50 %.2f p90 %.2f p99 %.2f max %.2f\n", Percentile(latencies, 0.0),
+		       Percentile(latencies, 0.5), Percentile(latencies, 0.9), Percentile(latencies, 0.99),
+		       Percentile(latencies, 1.0));
+
+	/* Only builds that coalesce interaction events report these */
+	if (after.contains("input_events"))
+		printf("plugin: %llu events delivered in %llu flushes\n",
+		       (unsigned long long)BenchStatDelta(before, after, "input_delivered"),
+		       (unsigned long long)BenchStatDelta(before, after, "input_flushes"));
+
+	BenchReleaseSource(bench.source);
+	BenchShutdown();
+	return latencies.empty() ? 1 : 0;
+}
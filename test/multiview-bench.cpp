@@ -0,0 +1,133 @@
+/******************************************************************************
+ Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/* Renders one notification source into 1, 4 and 16 multiview tiles per frame,
+ * like a scene shown in the program, the preview and several projectors.
+ *
+ * Prints the CPU time of the extra renders, the average libobs frame time,
+ * and how often the source uploaded and copied its texture per frame. With
+ * render-once the upload and copy counts stay flat as views are added. */
+
+#include "bench-common.hpp"
+#include <util/platform.h>
+#include <QApplication>
+#include <atomic>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static constexpr uint32_t BASE_WIDTH = 1920;
+static constexpr uint32_t BASE_HEIGHT = 1080;
+static constexpr int SOURCE_WIDTH = 1280;
+static constexpr int SOURCE_HEIGHT = 720;
+
+struct MultiviewRender {
+	obs_source_t *source = nullptr;
+	int views = 1;
+	std::atomic<uint64_t> render_ns = 0;
+	std::atomic<uint64_t> frames = 0;
+};
+
+static void RenderViews(void *param, uint32_t cx, uint32_t cy)
+{
+	MultiviewRender *render = (MultiviewRender *)param;
+	const int columns = (int)std::ceil(std::sqrt((double)render->views));
+	const float tile_cx = (float)cx / columns;
+	const float tile_cy = (float)cy / columns;
+
+	const uint64_t start = os_gettime_ns();
+	for (int i = 0; i < render->views; i++) {
+		gs_matrix_push();
+		gs_matrix_translate3f(tile_cx * (i % columns), tile_cy * (i / columns), 0.0f);
+		gs_matrix_scale3f(tile_cx / SOURCE_WIDTH, tile_cy / SOURCE_HEIGHT, 1.0f);
+		obs_source_video_render(render->source);
+		gs_matrix_pop();
+	}
+	render->render_ns += os_gettime_ns() - start;
+	render->frames++;
+}
+
+static void RunViews(obs_source_t *source, int views, int seconds)
+{
+	MultiviewRender render;
+	render.source = source;
+	render.views = views;
+
+	obs_add_main_render_callback(RenderViews, &render);
+	BenchRun(1000);
+
+	const nlohmann::json before = BenchGetStats(source);
+	const uint64_t render_ns = render.render_ns;
+	const uint64_t frames = render.frames;
+	const uint32_t lagged = obs_get_lagged_frames();
+
+	BenchRun(seconds * 1000);
+
+	const nlohmann::json after = BenchGetStats(source);
+	const double count = (double)(render.frames - frames);
+	const double cpu_ms = (double)(render.render_ns - render_ns) / 1000000.0 / count;
+	const double frame_ms = (double)obs_get_average_frame_time_ns() / 1000000.0;
+	const uint32_t lagged_frames = obs_get_lagged_frames() - lagged;
+	obs_remove_main_render_callback(RenderViews, &render);
+
+	printf("%5d %12.3f %10.3f %13.2f %12.2f %12.2f %8u\n", views, cpu_ms, frame_ms,
+	       BenchStatDelta(before, after, "render_calls") / count,
+	       BenchStatDelta(before, after, "frames_painted") / count,
+	       BenchStatDelta(before, after, "extra_copies") / count, lagged_frames);
+}
+
+int main(int argc, char **argv)
+{
+	QApplication app(argc, argv);
+
+	BenchOptions options;
+	int first_arg = 1;
+	if (!BenchParseOptions(argc, argv, options, first_arg)) {
+		fprintf(stderr, "usage: %s [--module path] [--seconds n] [views...]\n", argv[0]);
+		return 2;
+	}
+
+	std::vector<int> view_counts;
+	for (int i = first_arg; i < argc; i++) {
+		const int views = atoi(argv[i]);
+		if (views <= 0)
+			return 2;
+		view_counts.push_back(views);
+	}
+	if (view_counts.empty())
+		view_counts = {1, 4, 16};
+
+	if (!BenchStartup(options, BASE_WIDTH, BASE_HEIGHT))
+		return 1;
+
+	obs_source_t *source = BenchCreateSource("bench-animation.html", SOURCE_WIDTH, SOURCE_HEIGHT);
+	if (!source) {
+		BenchShutdown();
+		return 1;
+	}
+
+	printf("%5s %12s %10s %13s %12s %12s %8s\n", "views", "cpu ms/frame", "frame ms", "renders/frame",
+	       "paints/frame", "copies/frame", "lagged");
+	for (int views : view_counts)
+		RunViews(source, views, options.seconds);
+
+	BenchReleaseSource(source);
+	BenchShutdown();
+	return 0;
+}